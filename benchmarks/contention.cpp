@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2021 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+// Latency of the DevicesManager read methods while the simulated backend
+// keeps connecting and disconnecting a tracker, and the acquisition thread
+// computes the poses. The results are printed as JSON on the standard output,
+// or in the given file.
+//
+// The read methods must never block. On Linux, the benchmark fails if the
+// readers make voluntary context switches, i.e. if they wait for a lock or
+// for another thread, while the involuntary ones caused by the scheduler are
+// allowed.
+//
+// Usage: contention_benchmark [--readers N] [--duration s] [--eventsRate Hz]
+//                             [--samples N] [--output file]
+
+#include "OpenVRTrackersDriver.h"
+#include "SimulatedBackend.h"
+
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct Latencies
+    {
+        std::vector<double> initialized;
+        std::vector<double> type;
+        std::vector<double> pose;
+        std::vector<double> frameName;
+        std::vector<double> role;
+        std::vector<double> properties;
+        std::vector<double> managedDevices;
+
+        // Latencies of each read method, by name
+        std::vector<std::pair<std::string, std::vector<double>*>> all()
+        {
+            return {{"initialized", &initialized},
+                    {"type", &type},
+                    {"pose", &pose},
+                    {"frameName", &frameName},
+                    {"role", &role},
+                    {"properties", &properties},
+                    {"managedDevices", &managedDevices}};
+        }
+    };
+
+    // Voluntary context switches of the calling thread, negative when they
+    // cannot be measured
+    long VoluntaryContextSwitches()
+    {
+#ifdef __linux__
+        rusage usage;
+        if (getrusage(RUSAGE_THREAD, &usage) == 0) {
+            return usage.ru_nvcsw;
+        }
+#endif
+        return -1;
+    }
+
+    template <typename F>
+    void Measure(std::vector<double>& latencies, F&& function)
+    {
+        const auto start = Clock::now();
+        function();
+        const auto end = Clock::now();
+
+        // Growing the buffer would measure the allocator instead
+        if (latencies.size() < latencies.capacity()) {
+            latencies.push_back(
+                std::chrono::duration<double, std::nano>(end - start).count());
+        }
+    }
+
+    void PrintStatistics(std::ostream& out,
+                         const std::string& name,
+                         std::vector<double>& values)
+    {
+        std::sort(values.begin(), values.end());
+
+        const auto percentile = [&](const double p) {
+            return values.empty()
+                       ? 0.0
+                       : values[size_t(p * double(values.size() - 1))];
+        };
+
+        out << "    \"" << name << "\": {\"samples\": " << values.size()
+            << ", \"p50_ns\": " << percentile(0.50)
+            << ", \"p99_ns\": " << percentile(0.99)
+            << ", \"max_ns\": " << (values.empty() ? 0 : values.back())
+            << "}";
+    }
+} // namespace
+
+int main(int argc, char** argv)
+{
+    size_t readers = 2;
+    double duration = 2.0;
+    double eventsRate = 200.0;
+    size_t samples = 200000;
+    std::string output;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const std::string option = argv[i];
+
+        if (option == "--readers") {
+            readers = size_t(std::max(1, std::atoi(argv[i + 1])));
+        }
+        else if (option == "--duration") {
+            duration = std::atof(argv[i + 1]);
+        }
+        else if (option == "--eventsRate") {
+            eventsRate = std::atof(argv[i + 1]);
+        }
+        else if (option == "--samples") {
+            samples = size_t(std::max(1, std::atoi(argv[i + 1])));
+        }
+        else if (option == "--output") {
+            output = argv[i + 1];
+        }
+        else {
+            std::cerr << "Unknown option " << option << std::endl;
+            return 1;
+        }
+    }
+
+    // The last tracker is disconnected and connected again at the given rate
+    openvr::SimulatedBackend::Options options;
+    options.clock = openvr::SimulatedBackend::Clock::WallClock;
+
+    const auto toggled = vr::TrackedDeviceIndex_t(
+        options.hmds + options.trackingReferences + options.controllers
+        + options.genericTrackers - 1);
+
+    for (size_t i = 0; double(i) < (duration + 1.0) * eventsRate; ++i) {
+        options.events.push_back({double(i + 1) / eventsRate,
+                                  i % 2 == 0
+                                      ? vr::VREvent_TrackedDeviceDeactivated
+                                      : vr::VREvent_TrackedDeviceActivated,
+                                  toggled});
+    }
+
+    openvr::DevicesManager manager(
+        std::make_unique<openvr::SimulatedBackend>(std::move(options)));
+
+    if (!manager.setEventsPeriod(0.001) || !manager.initialize()
+        || !manager.startAcquisition(0.002)) {
+        std::cerr << "Failed to initialize the manager" << std::endl;
+        return 1;
+    }
+
+    // Wait the first poses
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    const std::string serial = manager.managedDevices().front();
+    std::atomic<bool> running = true;
+    std::vector<Latencies> latencies(readers);
+    std::vector<long> switches(readers, 0);
+    std::vector<std::thread> threads;
+
+    for (size_t r = 0; r < readers; ++r) {
+        threads.emplace_back([&, r]() {
+            Latencies& l = latencies[r];
+
+            // Allocate and touch the buffers before measuring
+            for (auto& method : l.all()) {
+                method.second->assign(samples, 0.0);
+                method.second->clear();
+            }
+
+            const long initialSwitches = VoluntaryContextSwitches();
+
+            while (running) {
+                Measure(l.initialized, [&]() { manager.initialized(); });
+                Measure(l.type, [&]() { manager.type(serial); });
+                Measure(l.pose, [&]() { manager.pose(serial); });
+                Measure(l.frameName, [&]() { manager.frameName(serial); });
+                Measure(l.role, [&]() { manager.role(serial); });
+                Measure(l.properties, [&]() { manager.properties(serial); });
+                Measure(l.managedDevices,
+                        [&]() { manager.managedDevices(); });
+            }
+
+            const long finalSwitches = VoluntaryContextSwitches();
+            switches[r] = initialSwitches < 0 || finalSwitches < 0
+                              ? -1
+                              : finalSwitches - initialSwitches;
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+    running = false;
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    manager.stopAcquisition();
+
+    Latencies all;
+    for (Latencies& l : latencies) {
+        const auto from = l.all();
+        const auto to = all.all();
+        for (size_t i = 0; i < to.size(); ++i) {
+            to[i].second->insert(to[i].second->end(),
+                                 from[i].second->begin(),
+                                 from[i].second->end());
+        }
+    }
+
+    // The readers blocked if any of them switched voluntarily
+    long blockingSwitches = 0;
+    for (const long s : switches) {
+        blockingSwitches = s < 0 ? -1 : blockingSwitches + s;
+        if (s < 0) {
+            break;
+        }
+    }
+
+    std::ofstream file;
+    if (!output.empty()) {
+        file.open(output);
+    }
+    std::ostream& out = output.empty() ? std::cout : file;
+
+    out << "{\n"
+        << "  \"benchmark\": \"contention\",\n"
+        << "  \"readers\": " << readers << ",\n"
+        << "  \"duration_s\": " << duration << ",\n"
+        << "  \"events_rate_hz\": " << eventsRate << ",\n"
+        << "  \"readers_voluntary_switches\": " << blockingSwitches << ",\n"
+        << "  \"latencies\": {\n";
+
+    const auto methods = all.all();
+    for (size_t i = 0; i < methods.size(); ++i) {
+        PrintStatistics(out, methods[i].first, *methods[i].second);
+        out << (i + 1 < methods.size() ? ",\n" : "\n");
+    }
+    out << "  }\n}" << std::endl;
+
+    if (blockingSwitches > 0) {
+        std::cerr << "The readers blocked " << blockingSwitches << " times"
+                  << std::endl;
+        return 1;
+    }
+
+    return out ? 0 : 1;
+}
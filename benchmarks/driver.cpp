@@ -0,0 +1,359 @@
+/*
+ * Copyright (C) 2021 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+// Cost of the hot paths of the driver and of the module running on the
+// simulated backend, for a growing number of devices. The results are
+// printed as JSON on the standard output, or in the given file.
+//
+// The publication of the module is measured through openvr::Publication,
+// the same code of OpenVRTrackersModule::updateModule() without the ports.
+// The processing of the events is measured with storms of scripted events
+// that disconnect and connect again all the devices, processed by the
+// thread of the manager polling the runtime.
+//
+// Usage: driver_benchmark [--iterations N] [--readers N] [--output file]
+
+#include "OpenVRTrackersDriver.h"
+#include "PosesPacket.h"
+#include "Publication.h"
+#include "Rotations.h"
+#include "SimulatedBackend.h"
+
+#include <yarp/math/Quaternion.h>
+#include <yarp/os/Bottle.h>
+#include <yarp/sig/Matrix.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    constexpr size_t Repetitions = 5;
+    const std::vector<size_t> DeviceCounts = {1, 2, 4, 8, 16, 32, 64};
+
+    struct Result
+    {
+        std::string name;
+        size_t devices;
+        size_t iterations;
+        double nsPerOperation;
+    };
+
+    std::vector<Result> Results;
+
+    // Record the median over the repetitions of the average duration of
+    // the function
+    template <typename F>
+    void Run(const std::string& name,
+             const size_t devices,
+             const size_t iterations,
+             F&& function)
+    {
+        std::vector<double> durations;
+
+        for (size_t r = 0; r < Repetitions; ++r) {
+            const auto start = Clock::now();
+            for (size_t i = 0; i < iterations; ++i) {
+                function();
+            }
+            durations.push_back(
+                std::chrono::duration<double, std::nano>(Clock::now() - start)
+                    .count()
+                / double(iterations));
+        }
+
+        std::sort(durations.begin(), durations.end());
+        Results.push_back(
+            {name, devices, iterations, durations[Repetitions / 2]});
+    }
+
+    // The HMD is followed by generic trackers
+    std::unique_ptr<openvr::DevicesManager> CreateManager(const size_t devices)
+    {
+        openvr::SimulatedBackend::Options options;
+        options.hmds = 1;
+        options.controllers = 0;
+        options.genericTrackers = devices - 1;
+
+        auto manager = std::make_unique<openvr::DevicesManager>(
+            std::make_unique<openvr::SimulatedBackend>(std::move(options)));
+
+        if (!manager->initialize()) {
+            return nullptr;
+        }
+
+        return manager;
+    }
+
+    // Storms of events: the odd ones disconnect all the devices, the even
+    // ones connect them again, one storm per second of simulated time
+    std::unique_ptr<openvr::DevicesManager>
+    CreateStormManager(const size_t devices,
+                       const size_t storms,
+                       openvr::SimulatedBackend*& backend)
+    {
+        openvr::SimulatedBackend::Options options;
+        options.hmds = 1;
+        options.controllers = 0;
+        options.genericTrackers = devices - 1;
+        options.clock = openvr::SimulatedBackend::Clock::Stepped;
+
+        for (size_t storm = 1; storm <= storms; ++storm) {
+            for (size_t index = 0; index < devices; ++index) {
+                options.events.push_back(
+                    {double(storm),
+                     storm % 2 == 1 ? vr::VREvent_TrackedDeviceDeactivated
+                                    : vr::VREvent_TrackedDeviceActivated,
+                     vr::TrackedDeviceIndex_t(index)});
+            }
+        }
+
+        auto simulated =
+            std::make_unique<openvr::SimulatedBackend>(std::move(options));
+        backend = simulated.get();
+
+        auto manager =
+            std::make_unique<openvr::DevicesManager>(std::move(simulated));
+
+        // Poll the events as often as possible, the polling delay is part
+        // of the measure
+        if (!manager->setEventsPeriod(1e-5) || !manager->initialize()) {
+            return nullptr;
+        }
+
+        return manager;
+    }
+
+    // Conversion of the rotations of all the devices with the 4x4 matrix
+    // path used before the driver computed the quaternions
+    void MatrixQuaternions(const openvr::DevicesSnapshot& snapshot,
+                           yarp::sig::Matrix& buffer,
+                           yarp::math::Quaternion& quaternion,
+                           double& checksum)
+    {
+        for (size_t i = 0; i < snapshot.size; ++i) {
+            const openvr::Pose& pose = snapshot.devices[i].pose;
+            buffer.eye();
+
+            for (size_t row = 0; row < 3; ++row) {
+                for (size_t col = 0; col < 3; ++col) {
+                    buffer[row][col] = pose.rotationRowMajor[3 * row + col];
+                }
+                buffer[row][3] = pose.position[row];
+            }
+
+            quaternion.fromRotationMatrix(buffer);
+            checksum += quaternion.w();
+        }
+    }
+
+    // Conversion of the rotations of all the devices with the kernel used
+    // by the driver
+    void KernelQuaternions(const openvr::DevicesSnapshot& snapshot,
+                           double& checksum)
+    {
+        for (size_t i = 0; i < snapshot.size; ++i) {
+            double quaternion[4];
+            openvr::RotationToQuaternion(
+                snapshot.devices[i].pose.rotationRowMajor.data(), quaternion);
+            checksum += quaternion[0];
+        }
+    }
+
+    void PrintResults(std::ostream& out)
+    {
+        out << "[\n";
+        for (size_t i = 0; i < Results.size(); ++i) {
+            const Result& result = Results[i];
+            out << "  {\"name\": \"" << result.name
+                << "\", \"devices\": " << result.devices
+                << ", \"iterations\": " << result.iterations
+                << ", \"ns_per_op\": " << result.nsPerOperation << "}"
+                << (i + 1 < Results.size() ? "," : "") << "\n";
+        }
+        out << "]" << std::endl;
+    }
+} // namespace
+
+int main(int argc, char** argv)
+{
+    size_t iterations = 1000;
+    size_t readers = 2;
+    std::string output;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const std::string option = argv[i];
+
+        if (option == "--iterations") {
+            iterations = size_t(std::max(1, std::atoi(argv[i + 1])));
+        }
+        else if (option == "--readers") {
+            readers = size_t(std::max(1, std::atoi(argv[i + 1])));
+        }
+        else if (option == "--output") {
+            output = argv[i + 1];
+        }
+        else {
+            std::cerr << "Unknown option " << option << std::endl;
+            return 1;
+        }
+    }
+
+    for (const size_t devices : DeviceCounts) {
+        auto manager = CreateManager(devices);
+
+        if (!manager) {
+            std::cerr << "Failed to initialize the manager" << std::endl;
+            return 1;
+        }
+
+        const std::vector<std::string> serials = manager->managedDevices();
+        openvr::DevicesSnapshot snapshot;
+
+        Run("computePoses", devices, iterations, [&]() {
+            manager->computePoses();
+        });
+
+        Run("snapshot", devices, iterations, [&]() {
+            manager->snapshot(snapshot);
+        });
+
+        Run("pose", devices, iterations, [&]() {
+            for (const auto& serial : serials) {
+                manager->pose(serial);
+            }
+        });
+
+        Run("managedDevices", devices, iterations, [&]() {
+            manager->managedDevices();
+        });
+
+        // All the outputs of the module, with batched transforms
+        openvr::Publication publication;
+        publication.baseFrame = "openVR_origin";
+
+        yarp::os::Bottle transforms;
+        openvr::PosesPacket poses;
+        yarp::os::Bottle state;
+        const openvr::Publication::Messages messages = {
+            &transforms, &poses, &state};
+        double time = 0;
+
+        Run("publish", devices, iterations, [&]() {
+            publication.fill(
+                time += 0.01, {snapshot, snapshot, snapshot}, messages);
+        });
+
+        Run("updateModule", devices, iterations, [&]() {
+            manager->computePoses();
+            manager->snapshot(snapshot);
+            publication.fill(
+                time += 0.01, {snapshot, snapshot, snapshot}, messages);
+        });
+
+        yarp::sig::Matrix buffer(4, 4);
+        yarp::math::Quaternion quaternion;
+        double checksum = 0;
+
+        Run("matrixQuaternions", devices, iterations, [&]() {
+            MatrixQuaternions(snapshot, buffer, quaternion, checksum);
+        });
+
+        Run("kernelQuaternions", devices, iterations, [&]() {
+            KernelQuaternions(snapshot, checksum);
+        });
+
+        if (checksum == 0) {
+            std::cerr << "Unexpected quaternions" << std::endl;
+        }
+
+        // Resolve again the frame names of all the devices
+        Run("frameNames", devices, iterations, [&]() {
+            manager->setFrameNaming("/{type}/{serial}");
+        });
+
+        // Time from the dispatch of a storm of one event per device to the
+        // update of the managed devices
+        const size_t storms = std::max<size_t>(1, iterations / 10);
+        openvr::SimulatedBackend* backend = nullptr;
+        auto stormManager =
+            CreateStormManager(devices, Repetitions * storms, backend);
+
+        if (!stormManager) {
+            std::cerr << "Failed to initialize the manager" << std::endl;
+            return 1;
+        }
+
+        size_t storm = 0;
+
+        Run("eventStorm", devices, storms, [&]() {
+            const size_t expected = ++storm % 2 == 1 ? 0 : devices;
+            backend->advance(1.0);
+
+            while (stormManager->managedDevices().size() != expected) {
+                std::this_thread::yield();
+            }
+        });
+
+        stormManager.reset();
+
+        // Read the poses while the acquisition thread computes them
+        if (!manager->startAcquisition(0.001)) {
+            std::cerr << "Failed to start the acquisition" << std::endl;
+            return 1;
+        }
+
+        std::atomic<bool> running = true;
+        std::vector<std::thread> threads;
+
+        for (size_t r = 1; r < readers; ++r) {
+            threads.emplace_back([&]() {
+                openvr::DevicesSnapshot other;
+                while (running) {
+                    manager->latestSnapshot(other);
+                }
+            });
+        }
+
+        Run("latestSnapshotConcurrent", devices, iterations, [&]() {
+            manager->latestSnapshot(snapshot);
+        });
+
+        Run("poseConcurrent", devices, iterations, [&]() {
+            for (const auto& serial : serials) {
+                manager->pose(serial);
+            }
+        });
+
+        running = false;
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        manager->stopAcquisition();
+    }
+
+    if (output.empty()) {
+        PrintResults(std::cout);
+        return 0;
+    }
+
+    std::ofstream file(output);
+    PrintResults(file);
+    return file ? 0 : 1;
+}
@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2021 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef OPENVR_TRACKERS_LATENCY_HISTOGRAM_H
+#define OPENVR_TRACKERS_LATENCY_HISTOGRAM_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace openvr {
+    class LatencyHistogram;
+} // namespace openvr
+
+/**
+ * Lock-free histogram of durations.
+ *
+ * Durations are stored in nanoseconds in logarithmic buckets, each octave
+ * being split in 8 linear sub-buckets. Percentiles are therefore reported
+ * with a relative error lower than 12.5%, while the maximum is exact.
+ * Any thread can record values while others read the statistics.
+ */
+class openvr::LatencyHistogram
+{
+public:
+    // Durations are expressed in seconds
+    struct Statistics
+    {
+        uint64_t count = 0;
+        double p50 = 0;
+        double p99 = 0;
+        double max = 0;
+    };
+
+    LatencyHistogram() = default;
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    void record(const double seconds)
+    {
+        const uint64_t ns = seconds > 0 ? uint64_t(seconds * 1e9) : 0;
+
+        m_buckets[BucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+
+        uint64_t max = m_max.load(std::memory_order_relaxed);
+        while (ns > max
+               && !m_max.compare_exchange_weak(
+                   max, ns, std::memory_order_relaxed)) {
+        }
+    }
+
+    // Values recorded while the statistics are computed could be partially
+    // considered
+    Statistics statistics() const
+    {
+        Statistics statistics;
+        statistics.count = m_count.load(std::memory_order_relaxed);
+        statistics.max = double(m_max.load(std::memory_order_relaxed)) / 1e9;
+        statistics.p50 = std::min(percentile(0.50), statistics.max);
+        statistics.p99 = std::min(percentile(0.99), statistics.max);
+        return statistics;
+    }
+
+    void reset()
+    {
+        for (auto& bucket : m_buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+
+        m_count.store(0, std::memory_order_relaxed);
+        m_max.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr unsigned SubBucketBits = 3;
+    static constexpr uint64_t SubBuckets = 1 << SubBucketBits;
+    static constexpr size_t BucketsCount =
+        (64 - SubBucketBits + 1) * SubBuckets;
+
+    static unsigned MostSignificantBit(uint64_t value)
+    {
+        unsigned msb = 0;
+        for (unsigned shift = 32; shift > 0; shift /= 2) {
+            if (value >> shift) {
+                value >>= shift;
+                msb += shift;
+            }
+        }
+        return msb;
+    }
+
+    static size_t BucketIndex(const uint64_t ns)
+    {
+        // Values smaller than the number of sub-buckets have their own one
+        if (ns < SubBuckets) {
+            return size_t(ns);
+        }
+
+        const unsigned msb = MostSignificantBit(ns);
+        const uint64_t sub = (ns >> (msb - SubBucketBits)) & (SubBuckets - 1);
+        return size_t((msb - SubBucketBits + 1) * SubBuckets + sub);
+    }
+
+    static uint64_t BucketLowerBound(const size_t index)
+    {
+        if (index < SubBuckets) {
+            return index;
+        }
+
+        const uint64_t shift = index / SubBuckets - 1;
+        return (SubBuckets + index % SubBuckets) << shift;
+    }
+
+    // Upper bound of the bucket containing the given percentile [s]
+    double percentile(const double p) const
+    {
+        const uint64_t count = m_count.load(std::memory_order_relaxed);
+
+        if (count == 0) {
+            return 0;
+        }
+
+        // Nearest-rank definition, the smallest value not exceeded by a
+        // fraction p of the values
+        const uint64_t rank = std::clamp<uint64_t>(
+            uint64_t(std::ceil(p * double(count))), 1, count);
+        uint64_t cumulative = 0;
+
+        for (size_t i = 0; i < BucketsCount; ++i) {
+            cumulative += m_buckets[i].load(std::memory_order_relaxed);
+
+            if (cumulative >= rank) {
+                const uint64_t upper = i + 1 < BucketsCount
+                                           ? BucketLowerBound(i + 1) - 1
+                                           : UINT64_MAX;
+                return double(upper) / 1e9;
+            }
+        }
+
+        return double(m_max.load(std::memory_order_relaxed)) / 1e9;
+    }
+
+    std::array<std::atomic<uint64_t>, BucketsCount> m_buckets = {};
+    std::atomic<uint64_t> m_count{0};
+    std::atomic<uint64_t> m_max{0};
+};
+
+#endif // OPENVR_TRACKERS_LATENCY_HISTOGRAM_H
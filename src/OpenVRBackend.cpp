@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2021 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include "OpenVRBackend.h"
+
+#include <yarp/os/LogStream.h>
+
+openvr::OpenVRBackend::~OpenVRBackend()
+{
+    this->shutdown();
+}
+
+bool openvr::OpenVRBackend::initialize()
+{
+    if (m_vr) {
+        yError() << "OpenVR runtime already initialized";
+        return false;
+    }
+
+    vr::EVRInitError eError = vr::VRInitError_None;
+
+    // Start the application in Background:
+    //
+    // The application will not start SteamVR.
+    // If it is not already running the call with VR_Init will fail
+    // with VRInitError_Init_NoServerForBackgroundApp.
+    //
+    // https://github.com/ValveSoftware/openvr/wiki/API-Documentation#initialization-and-cleanup
+    //
+    if (m_vr = vr::VR_Init(&eError, vr::VRApplication_Background); !m_vr) {
+        m_vr = nullptr;
+        yError() << "Failed to initialize VR runtime";
+        yError() << vr::VR_GetVRInitErrorAsEnglishDescription(eError);
+        return false;
+    }
+
+    return true;
+}
+
+void openvr::OpenVRBackend::shutdown()
+{
+    if (!m_vr) {
+        return;
+    }
+
+    m_vr = nullptr;
+    vr::VR_Shutdown();
+}
+
+bool openvr::OpenVRBackend::running() const
+{
+    return m_vr && !std::string(m_vr->GetRuntimeVersion()).empty();
+}
+
+bool openvr::OpenVRBackend::isTrackedDeviceConnected(
+    const vr::TrackedDeviceIndex_t index) const
+{
+    return m_vr->IsTrackedDeviceConnected(index);
+}
+
+vr::ETrackedDeviceClass openvr::OpenVRBackend::trackedDeviceClass(
+    const vr::TrackedDeviceIndex_t index) const
+{
+    return m_vr->GetTrackedDeviceClass(index);
+}
+
+std::string openvr::OpenVRBackend::stringProperty(
+    const vr::TrackedDeviceIndex_t index,
+    const vr::ETrackedDeviceProperty property) const
+{
+    // Most properties fit a small buffer. The returned size includes the
+    // terminator, and it is the required size if the buffer is too small.
+    char buffer[256];
+    const uint32_t size = m_vr->GetStringTrackedDeviceProperty( //
+        index,
+        property,
+        buffer,
+        sizeof(buffer));
+
+    if (size == 0) {
+        return {};
+    }
+
+    if (size <= sizeof(buffer)) {
+        return std::string(buffer, size - 1);
+    }
+
+    // Read again longer values
+    std::string value(size, '\0');
+    m_vr->GetStringTrackedDeviceProperty(index, property, value.data(), size);
+    value.resize(size - 1);
+    return value;
+}
+
+int32_t openvr::OpenVRBackend::int32Property(
+    const vr::TrackedDeviceIndex_t index,
+    const vr::ETrackedDeviceProperty property) const
+{
+    return m_vr->GetInt32TrackedDeviceProperty(index, property);
+}
+
+float openvr::OpenVRBackend::floatProperty(
+    const vr::TrackedDeviceIndex_t index,
+    const vr::ETrackedDeviceProperty property) const
+{
+    return m_vr->GetFloatTrackedDeviceProperty(index, property);
+}
+
+bool openvr::OpenVRBackend::boolProperty(
+    const vr::TrackedDeviceIndex_t index,
+    const vr::ETrackedDeviceProperty property) const
+{
+    return m_vr->GetBoolTrackedDeviceProperty(index, property);
+}
+
+void openvr::OpenVRBackend::deviceToAbsoluteTrackingPose(
+    const vr::ETrackingUniverseOrigin origin,
+    const float predictedSecondsToPhotonsFromNow,
+    vr::TrackedDevicePose_t* poses,
+    const uint32_t count)
+{
+    m_vr->GetDeviceToAbsoluteTrackingPose(
+        origin, predictedSecondsToPhotonsFromNow, poses, count);
+}
+
+bool openvr::OpenVRBackend::timeSinceLastVsync(float& seconds,
+                                               uint64_t& frameCounter) const
+{
+    return m_vr->GetTimeSinceLastVsync(&seconds, &frameCounter);
+}
+
+bool openvr::OpenVRBackend::pollNextEvent(vr::VREvent_t& event)
+{
+    return m_vr->PollNextEvent(&event, sizeof(event));
+}
+
+void openvr::OpenVRBackend::acknowledgeQuit()
+{
+    m_vr->AcknowledgeQuit_Exiting();
+}
+
+void openvr::OpenVRBackend::resetZeroPose(
+    const vr::ETrackingUniverseOrigin origin)
+{
+    vr::VRChaperone()->ResetZeroPose(origin);
+}
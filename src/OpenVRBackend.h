@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2021 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef OPENVR_TRACKERS_OPENVR_BACKEND_H
+#define OPENVR_TRACKERS_OPENVR_BACKEND_H
+
+#include "TrackingBackend.h"
+
+namespace openvr {
+    class OpenVRBackend;
+} // namespace openvr
+
+/**
+ * Tracking backend connected to a running SteamVR instance.
+ */
+class openvr::OpenVRBackend final : public openvr::TrackingBackend
+{
+public:
+    OpenVRBackend() = default;
+    ~OpenVRBackend() override;
+
+    bool initialize() override;
+    void shutdown() override;
+    bool running() const override;
+
+    bool isTrackedDeviceConnected(
+        const vr::TrackedDeviceIndex_t index) const override;
+    vr::ETrackedDeviceClass
+    trackedDeviceClass(const vr::TrackedDeviceIndex_t index) const override;
+    std::string
+    stringProperty(const vr::TrackedDeviceIndex_t index,
+                   const vr::ETrackedDeviceProperty property) const override;
+    int32_t
+    int32Property(const vr::TrackedDeviceIndex_t index,
+                  const vr::ETrackedDeviceProperty property) const override;
+    float
+    floatProperty(const vr::TrackedDeviceIndex_t index,
+                  const vr::ETrackedDeviceProperty property) const override;
+    bool
+    boolProperty(const vr::TrackedDeviceIndex_t index,
+                 const vr::ETrackedDeviceProperty property) const override;
+
+    void
+    deviceToAbsoluteTrackingPose(const vr::ETrackingUniverseOrigin origin,
+                                 const float predictedSecondsToPhotonsFromNow,
+                                 vr::TrackedDevicePose_t* poses,
+                                 const uint32_t count) override;
+
+    bool timeSinceLastVsync(float& seconds,
+                            uint64_t& frameCounter) const override;
+
+    bool pollNextEvent(vr::VREvent_t& event) override;
+    void acknowledgeQuit() override;
+
+    void resetZeroPose(const vr::ETrackingUniverseOrigin origin) override;
+
+private:
+    vr::IVRSystem* m_vr = nullptr;
+};
+
+#endif // OPENVR_TRACKERS_OPENVR_BACKEND_H
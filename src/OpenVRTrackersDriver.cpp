@@ -9,12 +9,24 @@
  */
 
 #include "OpenVRTrackersDriver.h"
+#include "OpenVRBackend.h"
+#include "RcuPointer.h"
+#include "Rotations.h"
+#include "SeqLock.h"
+#include "TrackingBackend.h"
 
 #include <openvr.h>
 #include <yarp/os/LogStream.h>
+#include <yarp/os/Time.h>
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <thread>
 #include <unordered_map>
@@ -23,20 +35,203 @@
 // DevicesManager::Impl
 // ====================
 
+static_assert(openvr::MaxTrackedDevices == vr::k_unMaxTrackedDeviceCount);
+
 class openvr::DevicesManager::Impl
 {
 public:
-    using TrackedDeviceSerialNumber = std::string;
-    std::unordered_map<TrackedDeviceSerialNumber, TrackedDevice> devices;
+    explicit Impl(std::unique_ptr<TrackingBackend> trackingBackend)
+        : backend(std::move(trackingBackend))
+    {}
+
+    template <typename T>
+    using Column = std::array<T, MaxTrackedDevices>;
+
+    // Structure of arrays storing the managed devices. Each device occupies
+    // the slot matching its OpenVR device index.
+    //
+    // A published set is never modified. Devices are added and removed by
+    // copying the current set and publishing the copy through an
+    // RcuPointer, therefore readers never wait for the processing of the
+    // events.
+    struct DevicesSet
+    {
+        size_t size = 0;
+        Column<bool> managed = {};
+        Column<TrackedDeviceType> type = {};
+        Column<std::string> serialNumber;
+        Column<std::string> frameName;
+        Column<DeviceProperties> properties;
+        Column<Transform> offset;
+
+        // Secondary index {serial -> slot} used by serial-based lookups
+        std::unordered_map<std::string, size_t> slots;
+
+        std::optional<size_t> slot(const std::string& serial) const
+        {
+            const auto it = slots.find(serial);
+            return it != slots.end() ? std::optional(it->second)
+                                     : std::nullopt;
+        }
+    };
+
+    // Structure of arrays storing the state computed by computePoses()
+    struct StatesTable
+    {
+        Column<bool> connected = {};
+        Column<bool> valid = {};
+        Column<Pose> pose = {};
+
+        // Time the last valid poses refer to
+        Column<double> timestamp = {};
 
-    vr::IVRSystem* vr = nullptr;
-    TrackingUniverseOrigin origin;
+        // Velocities of the last valid poses, used for the extrapolation
+        Column<vr::HmdVector3_t> velocity = {};
+        Column<vr::HmdVector3_t> angularVelocity = {};
+    };
+
+    // Read with readDevices(), modified holding devicesMutex
+    RcuPointer<DevicesSet> devices{std::make_unique<const DevicesSet>()};
+
+    // Serializes the modifications of the devices set, the frame naming
+    // and the processing of the events. It is held by the thread processing
+    // the events (detector or acquisition) and by the configuration
+    // methods. It does not cover the backend calls, see runtime().
+    std::recursive_mutex devicesMutex;
+
+    StatesTable states;
+
+    // Serializes all the calls to the backend, whatever thread makes them.
+    // No other mutex is locked while holding it.
+    mutable std::mutex backendMutex;
+
+    // The backend is not thread-safe, and the events and the poses are
+    // processed by different threads holding different mutexes. The backend
+    // is therefore only reachable through runtime().
+    // Backend locked until the end of the full expression using it, as in
+    // runtime()->pollNextEvent(event)
+    class LockedBackend
+    {
+    public:
+        LockedBackend(std::mutex& mutex, TrackingBackend& backend)
+            : m_lock(mutex)
+            , m_backend(backend)
+        {}
+
+        TrackingBackend* operator->() const { return &m_backend; }
+        TrackingBackend& operator*() const { return m_backend; }
+
+    private:
+        std::unique_lock<std::mutex> m_lock;
+        TrackingBackend& m_backend;
+    };
+
+    LockedBackend runtime() const
+    {
+        return LockedBackend(backendMutex, *backend);
+    }
+
+    bool hasBackend() const { return backend != nullptr; }
+
+    // Runtime state read without locks. It is cleared when the runtime
+    // quits or stops running.
+    std::atomic<bool> attached = false;
+    std::atomic<size_t> attachments = 0;
+
+    // Set by connect(), the detector thread then attaches the runtime
+    // whenever it is not attached
+    std::atomic<bool> reconnect = false;
+    std::atomic<double> minReconnectionDelay = 0.5;
+    std::atomic<double> maxReconnectionDelay = 5.0;
+
+    // Set by the destructor, no runtime is attached afterwards
+    std::atomic<bool> closing = false;
 
     std::thread detector;
+    std::atomic<double> eventsPeriod = 0.1;
 
+    // Protects the states, the poses and the settings used to compute them.
+    // It is held by computePoses() on the acquisition or the caller thread,
+    // concurrently with the processing of the events, so it does not cover
+    // the backend calls either. The lock order is devicesMutex, mutex, then
+    // backendMutex.
     mutable std::recursive_mutex mutex;
 
-    std::vector<vr::TrackedDevicePose_t> poses;
+    // Poses fetched from the runtime, addressed by device index
+    std::array<vr::TrackedDevicePose_t, MaxTrackedDevices> poses = {};
+
+    // Time the poses were fetched, and time they refer to considering the
+    // prediction
+    double posesTimestamp = 0;
+    double predictedTimestamp = 0;
+
+    // Devices allowed to be managed, protected by devicesMutex
+    DeviceSelection selection;
+
+    std::string frameNameTemplate = "/{type}/{serial}";
+    std::unordered_map<std::string, std::string> frameNames;
+    std::unordered_map<std::string, Transform> frameOffsets;
+
+    TrackingUniverseOrigin origin = TrackingUniverseOrigin::Seated;
+    PredictionMode predictionMode = PredictionMode::Runtime;
+    double predictionHorizon = 0;
+
+    // Transform applied to the poses of all the devices, protected by mutex
+    Transform universeTransform;
+
+    // Trivially copyable copy of the state of the managed devices, shared
+    // with lock-free readers through a sequence lock
+    static constexpr size_t SerialNumberCapacity = 64;
+    static constexpr size_t FrameNameCapacity = 128;
+
+    struct DeviceSample
+    {
+        size_t index;
+        TrackedDeviceType type;
+        bool connected;
+        bool valid;
+        Pose pose;
+        double timestamp;
+        std::array<char, SerialNumberCapacity> serialNumber;
+        std::array<char, FrameNameCapacity> frameName;
+    };
+
+    struct Samples
+    {
+        double timestamp;
+        double acquisitionTimestamp;
+        size_t size;
+        std::array<DeviceSample, MaxTrackedDevices> devices;
+    };
+
+    Samples samplesBuffer = {};
+    SeqLock<Samples> samples;
+
+    // Latest sample of each slot, read by pose() without copying the
+    // samples of all the devices
+    std::array<SeqLock<DeviceSample>, MaxTrackedDevices> deviceSamples;
+
+    std::thread acquisition;
+    std::atomic<bool> acquiring = false;
+
+    LatencyHistogram computePosesDurations;
+
+    // Lock-free access to the devices set, the guard must not be held
+    // while modifying it
+    RcuPointer<DevicesSet>::ReadGuard readDevices() const
+    {
+        return devices.read();
+    }
+
+    // The following methods must be called holding devicesMutex
+    const DevicesSet& currentDevices() const { return devices.current(); }
+
+    // It waits for the readers of the replaced set, and invalidates the
+    // references returned by currentDevices()
+    void storeDevices(std::unique_ptr<const DevicesSet> set)
+    {
+        devices.update(std::move(set));
+    }
 
     static bool DeviceTypeIsSupported(const TrackedDeviceType type)
     {
@@ -50,227 +245,960 @@ public:
         }
     }
 
+    std::string deviceRole(const size_t index,
+                           const TrackedDeviceType type,
+                           const std::string& controllerType) const
+    {
+        switch (type) {
+            case TrackedDeviceType::HMD:
+                return "head";
+            case TrackedDeviceType::Controller:
+                switch (runtime()->int32Property(
+                    index, vr::Prop_ControllerRoleHint_Int32)) {
+                    case vr::TrackedControllerRole_LeftHand:
+                        return "left_hand";
+                    case vr::TrackedControllerRole_RightHand:
+                        return "right_hand";
+                    default:
+                        return "";
+                }
+            case TrackedDeviceType::GenericTracker: {
+                // The controller type of trackers with a role assigned in
+                // SteamVR ends with the role, e.g. "vive_tracker_left_foot"
+                const std::string prefix = "tracker_";
+                const size_t position = controllerType.rfind(prefix);
+
+                return position != std::string::npos
+                           ? controllerType.substr(position + prefix.size())
+                           : "";
+            }
+            default:
+                return "";
+        }
+    }
+
+    // Each property is a call to the runtime, therefore they are read only
+    // when devices are added or updated. The backend is locked for each
+    // call, so that the poses can be computed between them.
+    DeviceProperties readProperties(const size_t index,
+                                    const TrackedDeviceType type) const
+    {
+        DeviceProperties properties;
+        properties.serialNumber =
+            runtime()->stringProperty(index, vr::Prop_SerialNumber_String);
+        properties.modelNumber =
+            runtime()->stringProperty(index, vr::Prop_ModelNumber_String);
+        properties.controllerType =
+            runtime()->stringProperty(index, vr::Prop_ControllerType_String);
+        properties.firmwareVersion = runtime()->stringProperty(
+            index, vr::Prop_TrackingFirmwareVersion_String);
+        properties.role = deviceRole(index, type, properties.controllerType);
+        properties.wireless =
+            runtime()->boolProperty(index, vr::Prop_DeviceIsWireless_Bool);
+
+        if (properties.wireless) {
+            properties.charging = runtime()->boolProperty(
+                index, vr::Prop_DeviceIsCharging_Bool);
+            properties.batteryLevel = runtime()->floatProperty(
+                index, vr::Prop_DeviceBatteryPercentage_Float);
+        }
+
+        return properties;
+    }
+
     static std::string
-    GetStringProperty(vr::IVRSystem& vr,
-                      const uint32_t index,
-                      const vr::ETrackedDeviceProperty property)
+    FormatFrameName(const std::string& nameTemplate,
+                    const std::unordered_map<std::string, std::string>& names,
+                    const size_t index,
+                    const std::string& serialNumber,
+                    const TrackedDeviceType type,
+                    const std::string& role)
     {
-        // Allocate the buffer using the maximum allowed size
-        char buffer[vr::k_unMaxPropertyStringSize];
-
-        // Get the string property
-        vr.GetStringTrackedDeviceProperty( //
-            index,
-            property,
-            buffer,
-            vr::k_unMaxPropertyStringSize);
-
-        // Convert to std::string
-        return std::string(buffer);
-    };
+        if (const auto it = names.find(serialNumber); it != names.end()) {
+            return it->second;
+        }
+
+        const std::array<std::pair<std::string, std::string>, 4> values = {{
+            {"{serial}", serialNumber},
+            {"{type}", TrackedDeviceTypeName(type)},
+            {"{index}", std::to_string(index)},
+            {"{role}", role},
+        }};
+
+        std::string name = nameTemplate;
+        for (const auto& [placeholder, value] : values) {
+            for (size_t pos = name.find(placeholder); pos != std::string::npos;
+                 pos = name.find(placeholder, pos + value.size())) {
+                name.replace(pos, placeholder.size(), value);
+            }
+        }
+
+        return name;
+    }
+
+    static Transform
+    ResolveOffset(const std::unordered_map<std::string, Transform>& offsets,
+                  const std::string& serialNumber,
+                  const std::string& role)
+    {
+        if (const auto it = offsets.find(serialNumber); it != offsets.end()) {
+            return it->second;
+        }
+
+        if (const auto it = offsets.find(role); it != offsets.end()) {
+            return it->second;
+        }
+
+        return {};
+    }
+
+    // Move the frame of the pose by an offset expressed in the frame itself,
+    // and express the result in the frame given by the universe transform
+    static void ApplyTransforms(Pose& pose,
+                                const Transform& universe,
+                                const Transform& offset)
+    {
+        const auto R = pose.rotationRowMajor;
+        const auto& Ro = offset.rotationRowMajor;
+        const auto& p = offset.position;
+
+        // Offset of the origin expressed in the tracking universe frame
+        double d[3];
+        for (size_t row = 0; row < 3; ++row) {
+            d[row] = R[3 * row] * p[0] + R[3 * row + 1] * p[1]
+                     + R[3 * row + 2] * p[2];
+            pose.position[row] += d[row];
+
+            for (size_t col = 0; col < 3; ++col) {
+                pose.rotationRowMajor[3 * row + col] =
+                    R[3 * row] * Ro[col] + R[3 * row + 1] * Ro[3 + col]
+                    + R[3 * row + 2] * Ro[6 + col];
+            }
+        }
+
+        // The moved origin also moves with the rotation of the device
+        const auto& w = pose.angularVelocity;
+        pose.linearVelocity[0] += w[1] * d[2] - w[2] * d[1];
+        pose.linearVelocity[1] += w[2] * d[0] - w[0] * d[2];
+        pose.linearVelocity[2] += w[0] * d[1] - w[1] * d[0];
+
+        const auto& Ru = universe.rotationRowMajor;
+        const auto rotate = [&Ru](std::array<double, 3>& v) {
+            const auto u = v;
+            for (size_t row = 0; row < 3; ++row) {
+                v[row] = Ru[3 * row] * u[0] + Ru[3 * row + 1] * u[1]
+                         + Ru[3 * row + 2] * u[2];
+            }
+        };
+
+        rotate(pose.position);
+        rotate(pose.linearVelocity);
+        rotate(pose.angularVelocity);
+        for (size_t i = 0; i < 3; ++i) {
+            pose.position[i] += universe.position[i];
+        }
+
+        const auto Rd = pose.rotationRowMajor;
+        for (size_t row = 0; row < 3; ++row) {
+            for (size_t col = 0; col < 3; ++col) {
+                pose.rotationRowMajor[3 * row + col] =
+                    Ru[3 * row] * Rd[col] + Ru[3 * row + 1] * Rd[3 + col]
+                    + Ru[3 * row + 2] * Rd[6 + col];
+            }
+        }
+    }
+
+    static bool PoseIsValid(const vr::TrackedDevicePose_t& pose)
+    {
+        return pose.bDeviceIsConnected
+               && pose.eTrackingResult
+                      == vr::ETrackingResult::TrackingResult_Running_OK
+               && pose.bPoseIsValid;
+    }
+
+    static Pose ToPose(const vr::TrackedDevicePose_t& pose)
+    {
+        Pose out;
+        out.position = {
+            pose.mDeviceToAbsoluteTracking.m[0][3],
+            pose.mDeviceToAbsoluteTracking.m[1][3],
+            pose.mDeviceToAbsoluteTracking.m[2][3],
+        };
+        out.rotationRowMajor = {
+            pose.mDeviceToAbsoluteTracking.m[0][0],
+            pose.mDeviceToAbsoluteTracking.m[0][1],
+            pose.mDeviceToAbsoluteTracking.m[0][2],
+            pose.mDeviceToAbsoluteTracking.m[1][0],
+            pose.mDeviceToAbsoluteTracking.m[1][1],
+            pose.mDeviceToAbsoluteTracking.m[1][2],
+            pose.mDeviceToAbsoluteTracking.m[2][0],
+            pose.mDeviceToAbsoluteTracking.m[2][1],
+            pose.mDeviceToAbsoluteTracking.m[2][2],
+        };
+        out.linearVelocity = {
+            pose.vVelocity.v[0],
+            pose.vVelocity.v[1],
+            pose.vVelocity.v[2],
+        };
+        out.angularVelocity = {
+            pose.vAngularVelocity.v[0],
+            pose.vAngularVelocity.v[1],
+            pose.vAngularVelocity.v[2],
+        };
+        out.trackingResult = TrackingResult(pose.eTrackingResult);
+        return out;
+    }
+
+    // Extrapolate the pose after `dt` seconds. The angular velocity is
+    // expressed in the tracking universe frame.
+    static void Extrapolate(Pose& pose,
+                            const vr::HmdVector3_t& v,
+                            const vr::HmdVector3_t& a,
+                            const vr::HmdVector3_t& w,
+                            const vr::HmdVector3_t& alpha,
+                            const double dt)
+    {
+        for (size_t i = 0; i < 3; ++i) {
+            pose.position[i] += v.v[i] * dt + 0.5 * a.v[i] * dt * dt;
+            pose.linearVelocity[i] = v.v[i] + a.v[i] * dt;
+            pose.angularVelocity[i] = w.v[i] + alpha.v[i] * dt;
+        }
+
+        // Rotation vector of the displacement
+        const std::array<double, 3> r = {
+            w.v[0] * dt + 0.5 * alpha.v[0] * dt * dt,
+            w.v[1] * dt + 0.5 * alpha.v[1] * dt * dt,
+            w.v[2] * dt + 0.5 * alpha.v[2] * dt * dt,
+        };
+
+        const double angle = std::sqrt(r[0] * r[0] + r[1] * r[1] + r[2] * r[2]);
+
+        if (angle < 1e-9) {
+            return;
+        }
+
+        // Rodrigues formula: R = I + sin(angle) K + (1 - cos(angle)) K^2
+        const double k[3] = {r[0] / angle, r[1] / angle, r[2] / angle};
+        const double s = std::sin(angle);
+        const double c = 1 - std::cos(angle);
+
+        const double delta[3][3] = {
+            {1 - c * (k[1] * k[1] + k[2] * k[2]),
+             -s * k[2] + c * k[0] * k[1],
+             s * k[1] + c * k[0] * k[2]},
+            {s * k[2] + c * k[0] * k[1],
+             1 - c * (k[0] * k[0] + k[2] * k[2]),
+             -s * k[0] + c * k[1] * k[2]},
+            {-s * k[1] + c * k[0] * k[2],
+             s * k[0] + c * k[1] * k[2],
+             1 - c * (k[0] * k[0] + k[1] * k[1])},
+        };
+
+        // Apply the displacement in the universe frame
+        const auto R = pose.rotationRowMajor;
+        for (size_t row = 0; row < 3; ++row) {
+            for (size_t col = 0; col < 3; ++col) {
+                pose.rotationRowMajor[3 * row + col] =
+                    delta[row][0] * R[0 + col] + delta[row][1] * R[3 + col]
+                    + delta[row][2] * R[6 + col];
+            }
+        }
+    }
+
+    // Seconds from now passed to the runtime prediction
+    float runtimePrediction() const
+    {
+        switch (predictionMode) {
+            case PredictionMode::Runtime:
+                return float(predictionHorizon);
+            case PredictionMode::RuntimeVsync: {
+                float sinceVsync = 0;
+                uint64_t frameCounter = 0;
+                if (!runtime()->timeSinceLastVsync(sinceVsync, frameCounter)) {
+                    return float(predictionHorizon);
+                }
+                return std::max(0.0f, float(predictionHorizon) - sinceVsync);
+            }
+            default:
+                return 0;
+        }
+    }
 
     bool computePoses()
     {
-        poses.resize(this->devices.size());
+        const auto lock = std::unique_lock(this->mutex);
+        const auto start = std::chrono::steady_clock::now();
+
+        if (!this->attached) {
+            return false;
+        }
+
+        // Devices added or removed from now on are considered from the
+        // next call
+        const auto devicesGuard = readDevices();
+        const DevicesSet& devices = *devicesGuard;
+
+        // The runtime fills the poses addressing them by device index.
+        // Device indices can be sparse (e.g. when base stations occupy
+        // lower indices), therefore the poses are fetched up to the highest
+        // managed index rather than up to the number of managed devices.
+        size_t count = 0;
+        for (size_t slot = 0; slot < MaxTrackedDevices; ++slot) {
+            if (devices.managed[slot]) {
+                count = slot + 1;
+            }
+        }
+
+        const double previousTimestamp = posesTimestamp;
+        const float runtimePrediction = this->runtimePrediction();
+        posesTimestamp = yarp::os::Time::now();
+
         // Get the device pose
-        this->vr->GetDeviceToAbsoluteTrackingPose(
+        this->runtime()->deviceToAbsoluteTrackingPose(
         vr::ETrackingUniverseOrigin(this->origin),
-        0,
-        &poses[0],
-        this->devices.size());
+        runtimePrediction,
+        poses.data(),
+        uint32_t(count));
+
+        const bool extrapolate =
+            predictionHorizon > 0
+            && (predictionMode == PredictionMode::ConstantVelocity
+                || predictionMode == PredictionMode::ConstantAcceleration);
+        const double dt = posesTimestamp - previousTimestamp;
+
+        // The poses refer to the future when predicted
+        predictedTimestamp =
+            posesTimestamp
+            + (extrapolate ? predictionHorizon : double(runtimePrediction));
+
+        // Extract the poses of the managed devices into the table
+        for (size_t slot = 0; slot < MaxTrackedDevices; ++slot) {
+            const bool fetched = devices.managed[slot] && slot < count;
+            const bool wasValid = states.valid[slot];
+            states.connected[slot] =
+                fetched && poses[slot].bDeviceIsConnected;
+            states.valid[slot] = fetched && PoseIsValid(poses[slot]);
+
+            if (!states.valid[slot]) {
+                states.pose[slot].trackingResult =
+                    fetched ? TrackingResult(poses[slot].eTrackingResult)
+                            : TrackingResult::Uninitialized;
+                continue;
+            }
+
+            const vr::TrackedDevicePose_t& pose = poses[slot];
+            states.pose[slot] = ToPose(pose);
+            states.timestamp[slot] = predictedTimestamp;
+
+            if (extrapolate) {
+                // Accelerations are estimated by finite differences of the
+                // velocities of consecutive valid samples
+                vr::HmdVector3_t a = {};
+                vr::HmdVector3_t alpha = {};
+
+                if (predictionMode == PredictionMode::ConstantAcceleration
+                    && wasValid && dt > 0) {
+                    for (size_t i = 0; i < 3; ++i) {
+                        a.v[i] = float(
+                            (pose.vVelocity.v[i] - states.velocity[slot].v[i])
+                            / dt);
+                        alpha.v[i] =
+                            float((pose.vAngularVelocity.v[i]
+                                   - states.angularVelocity[slot].v[i])
+                                  / dt);
+                    }
+                }
+
+                Extrapolate(states.pose[slot],
+                            pose.vVelocity,
+                            a,
+                            pose.vAngularVelocity,
+                            alpha,
+                            predictionHorizon);
+            }
+
+            states.velocity[slot] = pose.vVelocity;
+            states.angularVelocity[slot] = pose.vAngularVelocity;
+        }
+
+        // Align the frames of all the devices updated by this call in a
+        // single pass, devices without offset use the identity
+        for (size_t slot = 0; slot < count; ++slot) {
+            if (states.valid[slot]) {
+                ApplyTransforms(states.pose[slot],
+                                universeTransform,
+                                devices.offset[slot]);
+            }
+        }
+
+        // Convert the rotations of all the fetched devices in a single pass,
+        // then convert again the few ones close to a half turn
+        for (size_t slot = 0; slot < count; ++slot) {
+            RotationToQuaternion(states.pose[slot].rotationRowMajor.data(),
+                                 states.pose[slot].quaternion.data());
+        }
+        for (size_t slot = 0; slot < count; ++slot) {
+            Pose& pose = states.pose[slot];
+            if (CloseToHalfTurn(pose.rotationRowMajor.data())) {
+                RotationToQuaternionExact(pose.rotationRowMajor.data(),
+                                          pose.quaternion.data());
+            }
+        }
+
+        this->publishSamples(devices);
+
+        const std::chrono::duration<double> duration =
+            std::chrono::steady_clock::now() - start;
+        computePosesDurations.record(duration.count());
         return true;
     }
+
+    // The states must refer to the given devices
+    void publishSamples(const DevicesSet& devices)
+    {
+        samplesBuffer.timestamp = predictedTimestamp;
+        samplesBuffer.acquisitionTimestamp = posesTimestamp;
+        samplesBuffer.size = 0;
+
+        for (size_t slot = 0; slot < MaxTrackedDevices; ++slot) {
+
+            if (!devices.managed[slot]) {
+                continue;
+            }
+
+            DeviceSample& sample = samplesBuffer.devices[samplesBuffer.size++];
+            sample.index = slot;
+            sample.type = devices.type[slot];
+            sample.connected = states.connected[slot];
+            sample.valid = states.valid[slot];
+            sample.pose = states.pose[slot];
+            sample.timestamp = states.timestamp[slot];
+
+            // The lengths were checked when the device was added
+            const std::string& serial = devices.serialNumber[slot];
+            std::memcpy(sample.serialNumber.data(),
+                        serial.c_str(),
+                        serial.size() + 1);
+
+            const std::string& frameName = devices.frameName[slot];
+            std::memcpy(sample.frameName.data(),
+                        frameName.c_str(),
+                        frameName.size() + 1);
+
+            deviceSamples[slot].store(sample);
+        }
+
+        samples.store(samplesBuffer);
+    }
+
+    // Copy the latest samples in the caller storage
+    void loadSnapshot(DevicesSnapshot& snapshot) const
+    {
+        Samples latest;
+        samples.load(latest);
+        snapshot.timestamp = latest.timestamp;
+        snapshot.acquisitionTimestamp = latest.acquisitionTimestamp;
+        snapshot.size = 0;
+
+        for (size_t i = 0; i < latest.size; ++i) {
+            const DeviceSample& sample = latest.devices[i];
+            DeviceState& state = snapshot.devices[snapshot.size++];
+
+            state.index = sample.index;
+            state.serialNumber.assign(sample.serialNumber.data());
+            state.frameName.assign(sample.frameName.data());
+            state.type = sample.type;
+            state.timestamp = sample.timestamp;
+            state.valid = sample.valid;
+            state.pose = sample.pose;
+        }
+    }
+
+private:
+    std::unique_ptr<TrackingBackend> backend;
 };
 
+// ===============
+// DeviceSelection
+// ===============
+
+bool openvr::DeviceSelection::selects(const std::string& serialNumber,
+                                      const TrackedDeviceType type,
+                                      const std::string& role) const
+{
+    const auto matches = [](const auto& values, const auto& value) {
+        return values.empty()
+               || std::find(values.begin(), values.end(), value)
+                      != values.end();
+    };
+
+    return matches(serialNumbers, serialNumber) && matches(types, type)
+           && matches(roles, role);
+}
+
+// ==============
+// Free functions
+// ==============
+
+std::string openvr::TrackedDeviceTypeName(const TrackedDeviceType type)
+{
+    switch (type) {
+        case TrackedDeviceType::HMD:
+            return "hmd";
+        case TrackedDeviceType::Controller:
+            return "controllers";
+        case TrackedDeviceType::GenericTracker:
+            return "trackers";
+        default:
+            return "";
+    }
+}
+
 // ==============
 // DevicesManager
 // ==============
 
 openvr::DevicesManager::DevicesManager()
-    : pImpl{std::make_unique<Impl>()}
+    : DevicesManager(std::make_unique<OpenVRBackend>())
+{
+}
+
+openvr::DevicesManager::DevicesManager(std::unique_ptr<TrackingBackend> backend)
+    : pImpl{std::make_unique<Impl>(std::move(backend))}
 {
 }
 
 openvr::DevicesManager::~DevicesManager()
 {
-    if (this->initialized()) {
-        // Tear down the runtime
-        pImpl->vr = nullptr;
-        vr::VR_Shutdown();
+    this->stopAcquisition();
+
+    // Tear down the runtime, waiting the processing of pending events
+    pImpl->closing = true;
+    this->detach();
 
-        // Wait the processor thread to terminate
+    // Wait the detector thread to terminate. It could have already exited
+    // if the runtime was closed by a Quit event.
+    if (pImpl->detector.joinable()) {
         pImpl->detector.join();
     }
 }
 
 bool openvr::DevicesManager::initialized() const
 {
-    const auto lock = std::unique_lock(pImpl->mutex);
-    return pImpl->vr && !std::string(pImpl->vr->GetRuntimeVersion()).empty();
+    return pImpl->attached;
 }
 
 bool openvr::DevicesManager::initialize(const TrackingUniverseOrigin& vrOrigin)
 {
-    if (this->initialized()) {
+    if (this->initialized() || pImpl->reconnect) {
+        yError() << "Already initialized";
+        return false;
+    }
+
+    // The detector thread of a runtime that quit could still be exiting
+    if (pImpl->detector.joinable()) {
+        pImpl->detector.join();
+    }
+
+    pImpl->origin = vrOrigin;
+
+    yDebug() << "Initializing OpenVR DeviceManager";
+
+    if (!this->attach()) {
+        return false;
+    }
+
+    // Process the events in a dedicated thread
+    pImpl->detector = std::thread([this]() { this->runDetector(); });
+
+    yInfo("VR runtime succesfully initialized");
+    return true;
+}
+
+bool openvr::DevicesManager::connect(const TrackingUniverseOrigin& vrOrigin)
+{
+    if (this->initialized() || pImpl->reconnect) {
         yError() << "Already initialized";
         return false;
     }
 
+    if (pImpl->detector.joinable()) {
+        pImpl->detector.join();
+    }
+
+    pImpl->origin = vrOrigin;
+    pImpl->reconnect = true;
+
+    // The detector thread attaches the runtime and processes the events
+    pImpl->detector = std::thread([this]() { this->runDetector(); });
+
+    yInfo() << "Waiting for the VR runtime";
+    return true;
+}
+
+bool openvr::DevicesManager::setReconnectionDelays(const double minDelay,
+                                                   const double maxDelay)
+{
+    if (!(minDelay > 0) || !(maxDelay >= minDelay)) {
+        yError() << "Invalid reconnection delays" << minDelay << maxDelay;
+        return false;
+    }
+
+    pImpl->minReconnectionDelay = minDelay;
+    pImpl->maxReconnectionDelay = maxDelay;
+    return true;
+}
+
+size_t openvr::DevicesManager::attachments() const
+{
+    return pImpl->attachments;
+}
+
+bool openvr::DevicesManager::setTrackingUniverseOrigin(
+    const TrackingUniverseOrigin& vrOrigin)
+{
+    const auto lock = std::unique_lock(pImpl->mutex);
+
+    if (pImpl->origin == vrOrigin) {
+        return true;
+    }
+
+    // Velocities of different origins cannot be compared, the extrapolation
+    // starts over from the next valid poses
+    pImpl->origin = vrOrigin;
+    pImpl->states.valid.fill(false);
+    return true;
+}
+
+openvr::TrackingUniverseOrigin
+openvr::DevicesManager::trackingUniverseOrigin() const
+{
     const auto lock = std::unique_lock(pImpl->mutex);
+    return pImpl->origin;
+}
 
-        pImpl->origin = vrOrigin;
+bool openvr::DevicesManager::setEventsPeriod(const double period)
+{
+    if (!(period > 0)) {
+        yError() << "Invalid events period" << period;
+        return false;
+    }
 
-    // =================================
-    // Detect and track existing devices
-    // =================================
+    pImpl->eventsPeriod = period;
+    return true;
+}
 
-    yDebug() << "Initializing OpenVR DeviceManager";
-    vr::EVRInitError eError = vr::VRInitError_None;
+double openvr::DevicesManager::eventsPeriod() const
+{
+    return pImpl->eventsPeriod;
+}
 
-    // Start the application in Background:
-    //
-    // The application will not start SteamVR.
-    // If it is not already running the call with VR_Init will fail
-    // with VRInitError_Init_NoServerForBackgroundApp.
-    //
-    // https://github.com/ValveSoftware/openvr/wiki/API-Documentation#initialization-and-cleanup
-    //
-    if (pImpl->vr = vr::VR_Init(&eError, vr::VRApplication_Background);
-        !pImpl->vr) {
-        pImpl->vr = nullptr;
-        yError() << "Failed to initialize VR runtime";
-        yError() << vr::VR_GetVRInitErrorAsEnglishDescription(eError);
+bool openvr::DevicesManager::addDevice(const size_t index)
+{
+    const auto lock = std::unique_lock(pImpl->devicesMutex);
+
+    if (index >= MaxTrackedDevices) {
+        yError() << "Failed to add device with invalid index" << index;
         return false;
     }
 
-    yDebug() << "OpenVR runtime correctly started";
-    yDebug() << "Scanning for existing devices";
+    // Make sure the device is connected
+    yDebug() << "Checking if device is connected";
+    if (!pImpl->runtime()->isTrackedDeviceConnected(index)) {
+        yError() << "Failed to add unconnected device with index" << index;
+        return false;
+    }
+
+    // Get the type of the device
+    const TrackedDeviceType type =
+        TrackedDeviceType(pImpl->runtime()->trackedDeviceClass(index));
+
+    if (!Impl::DeviceTypeIsSupported(type)) {
+        yInfo() << "The device with index" << index << "has unsupported type";
+        return true;
+    }
+
+    // Read the properties once, the serial number is used as secondary key
+    // of the table where devices are stored
+    DeviceProperties properties = pImpl->readProperties(index, type);
+    const std::string& serialNumber = properties.serialNumber;
+
+    if (!pImpl->selection.selects(serialNumber, type, properties.role)) {
+        yInfo() << "The device" << serialNumber << "is not selected";
+        return true;
+    }
+
+    if (serialNumber.size() >= Impl::SerialNumberCapacity) {
+        yError() << "Failed to add device with index" << index
+                 << ", its serial number is too long";
+        return false;
+    }
+
+    const std::string frameName =
+        Impl::FormatFrameName(pImpl->frameNameTemplate,
+                              pImpl->frameNames,
+                              index,
+                              serialNumber,
+                              type,
+                              properties.role);
+
+    if (frameName.size() >= Impl::FrameNameCapacity) {
+        yError() << "Failed to add device" << serialNumber
+                 << ", its frame name is too long";
+        return false;
+    }
+
+    yDebug() << "Adding device" << serialNumber << " (index =" << index
+             << ", type =" << int(type) << ", frame =" << frameName << ")";
+
+    // Make sure the device is not already there
+    const Impl::DevicesSet& current = pImpl->currentDevices();
+    if (current.managed[index] || current.slot(serialNumber)) {
+        yError() << "Failed to insert device" << serialNumber
+                 << ". It was already inserted previously.";
+        return false;
+    }
+
+    // Insert the new device in a copy of the set
+    auto devices = std::make_unique<Impl::DevicesSet>(current);
+    devices->managed[index] = true;
+    devices->type[index] = type;
+    devices->serialNumber[index] = serialNumber;
+    devices->frameName[index] = frameName;
+    devices->offset[index] = Impl::ResolveOffset(
+        pImpl->frameOffsets, serialNumber, properties.role);
+    devices->slots.emplace(serialNumber, index);
+    devices->properties[index] = std::move(properties);
+    devices->size++;
+    pImpl->storeDevices(std::move(devices));
+
+    yInfo() << "Device " << serialNumber << "inserted (index=" << index
+            << ")";
+    return true;
+}
+
+bool openvr::DevicesManager::updateDevice(const size_t index)
+{
+    const auto lock = std::unique_lock(pImpl->devicesMutex);
+    const Impl::DevicesSet& current = pImpl->currentDevices();
+
+    // Only the properties of the managed devices are cached
+    if (index >= MaxTrackedDevices || !current.managed[index]) {
+        return false;
+    }
+
+    // Copied, the removal below replaces the current set
+    const std::string serialNumber = current.serialNumber[index];
+    const TrackedDeviceType type = current.type[index];
+
+    DeviceProperties properties = pImpl->readProperties(index, type);
+    properties.serialNumber = serialNumber;
+
+    if (!pImpl->selection.selects(serialNumber, type, properties.role)) {
+        yInfo() << "The device" << serialNumber << "is not selected anymore";
+        return this->removeDevice(serialNumber);
+    }
+
+    std::string frameName = Impl::FormatFrameName(pImpl->frameNameTemplate,
+                                                   pImpl->frameNames,
+                                                   index,
+                                                   serialNumber,
+                                                   type,
+                                                   properties.role);
+
+    if (frameName.size() >= Impl::FrameNameCapacity) {
+        yError() << "Failed to update device" << serialNumber
+                 << ", its frame name is too long";
+        return false;
+    }
+
+    // Update the device in a copy of the set
+    auto devices = std::make_unique<Impl::DevicesSet>(current);
+    devices->frameName[index] = std::move(frameName);
+    devices->offset[index] = Impl::ResolveOffset(
+        pImpl->frameOffsets, serialNumber, properties.role);
+    devices->properties[index] = std::move(properties);
+    pImpl->storeDevices(std::move(devices));
+    return true;
+}
+
+bool openvr::DevicesManager::removeDevice(const std::string& serialNumber)
+{
+    const auto lock = std::unique_lock(pImpl->devicesMutex);
+    const Impl::DevicesSet& current = pImpl->currentDevices();
+    const auto slot = current.slot(serialNumber);
 
-    // Get the indices of all the connected devices
-    const auto connectedDevicesIndices = [&]() -> std::vector<size_t> {
-        std::vector<size_t> indices = {};
+    if (!slot) {
+        yError() << "Device with serial" << serialNumber << "not found";
+        return false;
+    }
 
-        for (size_t i = 0; i < vr::k_unMaxTrackedDeviceCount; ++i) {
-            if (pImpl->vr->IsTrackedDeviceConnected(i)) {
-                indices.push_back(i);
-            }
-        }
+    yDebug() << "Removing device with serial" << serialNumber;
 
-        return indices;
-    }();
+    // Remove the device from a copy of the set
+    auto devices = std::make_unique<Impl::DevicesSet>(current);
+    devices->slots.erase(serialNumber);
+    devices->managed[*slot] = false;
+    devices->type[*slot] = TrackedDeviceType::Invalid;
+    devices->serialNumber[*slot].clear();
+    devices->frameName[*slot].clear();
+    devices->properties[*slot] = {};
+    devices->offset[*slot] = {};
+    devices->size--;
+    pImpl->storeDevices(std::move(devices));
+    return true;
+}
 
-    yDebug() << "Found" << connectedDevicesIndices.size() << "devices";
+std::vector<std::string> openvr::DevicesManager::managedDevices() const
+{
+    const auto devicesGuard = pImpl->readDevices();
+    const auto& devices = *devicesGuard;
 
-    // Add all the devices with supported types
-    for (const auto deviceIndex : connectedDevicesIndices) {
-        yDebug() << "Inserting device with index" << deviceIndex;
+    std::vector<std::string> managedDevicesSerials;
+    managedDevicesSerials.reserve(devices.size);
 
-        if (!this->addDevice(deviceIndex)) {
-            yError() << "Failed to add device with index" << deviceIndex;
-            return false;
+    // Return the serial numbers of the managed devices, sorted by index
+    for (size_t slot = 0; slot < MaxTrackedDevices; ++slot) {
+        if (devices.managed[slot]) {
+            managedDevicesSerials.push_back(devices.serialNumber[slot]);
         }
     }
 
-    // ==================================
-    // Execute a thread to process events
-    // ==================================
-
-    // Create the detector thread
-    auto detectorLoop = [this]() {
-        yDebug() << "Detector thread: starting";
-        this->clearEvents();
+    return managedDevicesSerials;
+}
 
-        while (this->initialized()) {
-            this->processEvents();
-            std::this_thread::sleep_for(std::chrono::seconds(1));
+bool openvr::DevicesManager::setDeviceSelection(
+    const DeviceSelection& selection)
+{
+    const auto lock = std::unique_lock(pImpl->devicesMutex);
+    pImpl->selection = selection;
+
+    // Remove the devices not selected anymore. Each removal replaces the
+    // current set, therefore it is read again at every iteration.
+    for (size_t slot = 0; slot < MaxTrackedDevices; ++slot) {
+        const Impl::DevicesSet& current = pImpl->currentDevices();
+        if (current.managed[slot]
+            && !selection.selects(current.serialNumber[slot],
+                                  current.type[slot],
+                                  current.properties[slot].role)) {
+            this->removeDevice(std::string(current.serialNumber[slot]));
         }
+    }
 
-        yDebug() << "Detector thread: exiting";
-    };
+    if (!this->initialized()) {
+        return true;
+    }
 
-    // Start the thread waiting initialization
-    pImpl->detector = std::thread(detectorLoop);
+    // Add the connected devices that were not selected
+    bool ok = true;
+    for (size_t index = 0; index < MaxTrackedDevices; ++index) {
+        if (!pImpl->currentDevices().managed[index]
+            && pImpl->runtime()->isTrackedDeviceConnected(index)) {
+            ok = this->addDevice(index) && ok;
+        }
+    }
 
-    yInfo("VR runtime succesfully initialized");
-    return true;
+    return ok;
 }
 
-bool openvr::DevicesManager::addDevice(const size_t index)
+openvr::DeviceSelection openvr::DevicesManager::deviceSelection() const
 {
-    const auto lock = std::unique_lock(pImpl->mutex);
+    const auto lock = std::unique_lock(pImpl->devicesMutex);
+    return pImpl->selection;
+}
 
-    // Make sure the device is connected
-    yDebug() << "Checking if device is connected";
-    if (!pImpl->vr->IsTrackedDeviceConnected(index)) {
-        yError() << "Failed to add unconnected device with index" << index;
-        return false;
-    }
+bool openvr::DevicesManager::setFrameNaming(
+    const std::string& nameTemplate,
+    const std::unordered_map<std::string, std::string>& names)
+{
+    const auto lock = std::unique_lock(pImpl->devicesMutex);
+    auto devices =
+        std::make_unique<Impl::DevicesSet>(pImpl->currentDevices());
 
-    // Get the serial number of the device, used as key in the map where
-    // devices are stored
-    std::string serialNumber = Impl::GetStringProperty(
-        *pImpl->vr, index, vr::Prop_SerialNumber_String);
+    // Resolve the names of the devices already managed
+    std::array<std::string, MaxTrackedDevices> frameNames;
+    for (size_t slot = 0; slot < MaxTrackedDevices; ++slot) {
 
-    // Get the type of the device
-    const TrackedDeviceType type =
-        TrackedDeviceType(pImpl->vr->GetTrackedDeviceClass(index));
+        if (!devices->managed[slot]) {
+            continue;
+        }
 
-    if (!Impl::DeviceTypeIsSupported(type)) {
-        yInfo() << "The device" << serialNumber << "has unsupported type";
-        return true;
+        frameNames[slot] =
+            Impl::FormatFrameName(nameTemplate,
+                                  names,
+                                  slot,
+                                  devices->serialNumber[slot],
+                                  devices->type[slot],
+                                  devices->properties[slot].role);
+
+        if (frameNames[slot].size() >= Impl::FrameNameCapacity) {
+            yError() << "The frame name of device"
+                     << devices->serialNumber[slot] << "is too long";
+            return false;
+        }
     }
 
-    // Create the device
-    yDebug() << "Adding device" << serialNumber << " (index =" << index
-             << ", type =" << int(type) << ")";
-    const auto device = [&]() {
-        TrackedDevice device;
-        device.type = type;
-        device.index = index;
-        device.serialNumber = serialNumber;
-        return device;
-    }();
+    pImpl->frameNameTemplate = nameTemplate;
+    pImpl->frameNames = names;
 
-    // Make sure the device is not already there
-    if (pImpl->devices.find(device.serialNumber) != pImpl->devices.end()) {
-        yError() << "Failed to insert device" << device.serialNumber
-                 << ". It was already inserted previously.";
-        return false;
+    for (size_t slot = 0; slot < MaxTrackedDevices; ++slot) {
+        if (devices->managed[slot]) {
+            devices->frameName[slot] = std::move(frameNames[slot]);
+        }
     }
 
-    // Insert the new device
-    pImpl->devices.insert(std::make_pair(device.serialNumber, device));
-    yInfo() << "Device " << device.serialNumber << "inserted (index=" << index
-            << ")";
+    pImpl->storeDevices(std::move(devices));
     return true;
 }
 
-bool openvr::DevicesManager::removeDevice(const std::string& serialNumber)
+std::string
+openvr::DevicesManager::frameName(const std::string& serialNumber) const
 {
-    const auto lock = std::unique_lock(pImpl->mutex);
-    const auto& device = pImpl->devices.extract(serialNumber);
+    const auto devices = pImpl->readDevices();
 
-    if (device.empty()) {
+    const auto slot = devices->slot(serialNumber);
+    if (!slot) {
         yError() << "Device with serial" << serialNumber << "not found";
-        return false;
+        return {};
     }
 
-    yDebug() << "Removing device with serial" << serialNumber;
+    return devices->frameName[*slot];
+}
+
+bool openvr::DevicesManager::setFrameOffsets(
+    const std::unordered_map<std::string, Transform>& offsets)
+{
+    const auto lock = std::unique_lock(pImpl->devicesMutex);
+    pImpl->frameOffsets = offsets;
+
+    // Resolve the offsets of the devices already managed
+    auto devices =
+        std::make_unique<Impl::DevicesSet>(pImpl->currentDevices());
+    for (size_t slot = 0; slot < MaxTrackedDevices; ++slot) {
+        if (devices->managed[slot]) {
+            devices->offset[slot] =
+                Impl::ResolveOffset(offsets,
+                                    devices->serialNumber[slot],
+                                    devices->properties[slot].role);
+        }
+    }
+
+    pImpl->storeDevices(std::move(devices));
     return true;
 }
 
-std::vector<std::string> openvr::DevicesManager::managedDevices() const
+std::optional<openvr::Transform>
+openvr::DevicesManager::frameOffset(const std::string& serialNumber) const
 {
-    std::vector<std::string> managedDevicesSerials;
-    managedDevicesSerials.reserve(pImpl->devices.size());
+    const auto devices = pImpl->readDevices();
 
-    // Return the serial numbers of the managed devices, stored as
-    // keys in the unordered map {serial -> TrackedDevice}
-    for (const auto& [serial, _] : pImpl->devices) {
-        managedDevicesSerials.push_back(serial);
+    const auto slot = devices->slot(serialNumber);
+    if (!slot) {
+        yError() << "Device with serial" << serialNumber << "not found";
+        return std::nullopt;
     }
 
-    return managedDevicesSerials;
+    return devices->offset[*slot];
 }
 
 openvr::TrackedDeviceType
@@ -282,15 +1210,42 @@ openvr::DevicesManager::type(const std::string& serialNumber) const
         return TrackedDeviceType::Invalid;
     }
 
-    const auto lock = std::unique_lock(pImpl->mutex);
+    const auto devices = pImpl->readDevices();
 
     // Make sure the device is tracked
-    if (pImpl->devices.find(serialNumber) == pImpl->devices.end()) {
-        yError();
+    const auto slot = devices->slot(serialNumber);
+    if (!slot) {
+        yError() << "Device with serial" << serialNumber << "not found";
         return TrackedDeviceType::Invalid;
     }
 
-    return pImpl->devices[serialNumber].type;
+    return devices->type[*slot];
+}
+
+std::string openvr::DevicesManager::role(const std::string& serialNumber) const
+{
+    const auto devices = pImpl->readDevices();
+
+    const auto slot = devices->slot(serialNumber);
+    if (!slot) {
+        yError() << "Device with serial" << serialNumber << "not found";
+        return {};
+    }
+
+    return devices->properties[*slot].role;
+}
+
+std::optional<openvr::DeviceProperties>
+openvr::DevicesManager::properties(const std::string& serialNumber) const
+{
+    const auto devices = pImpl->readDevices();
+
+    const auto slot = devices->slot(serialNumber);
+    if (!slot) {
+        return std::nullopt;
+    }
+
+    return devices->properties[*slot];
 }
 
 bool openvr::DevicesManager::computePoses()
@@ -307,59 +1262,174 @@ openvr::DevicesManager::pose(const std::string& serialNumber) const
         return std::nullopt;
     }
 
-    const auto lock = std::unique_lock(pImpl->mutex);
-
     // Make sure the device is tracked
-    if (pImpl->devices.find(serialNumber) == pImpl->devices.end()) {
-        yError();
+    const auto slot = pImpl->readDevices()->slot(serialNumber);
+    if (!slot) {
+        yError() << "Device with serial" << serialNumber << "not found";
         return std::nullopt;
     }
 
-    // Make sure the device is connected
-    if (!pImpl->vr->IsTrackedDeviceConnected(
-            pImpl->devices[serialNumber].index)) {
-        yError();
+    Impl::DeviceSample sample;
+    pImpl->deviceSamples[*slot].load(sample);
+
+    // The slot could still contain the sample of a previous device, or no
+    // sample if the poses were not computed after the device was added
+    if (serialNumber != sample.serialNumber.data()) {
+        yWarning() << "The pose of device" << serialNumber
+                   << "has not been computed yet";
         return std::nullopt;
     }
 
-    vr::TrackedDevicePose_t pose;
-
-    pose = pImpl->poses[pImpl->devices[serialNumber].index];
-    // Check whether the whole received state is valid
-    if (pose.eTrackingResult
-        != vr::ETrackingResult::TrackingResult_Running_OK) {
-        yError() << "The state of the output of device" << serialNumber
-                 << "is not ok";
+    // Make sure the device is connected
+    if (!sample.connected) {
+        yError() << "Device with serial" << serialNumber << "not connected";
         return std::nullopt;
     }
 
     // Check pose validity
-    if (!pose.bPoseIsValid) {
+    if (!sample.valid) {
         yWarning() << "The pose of device" << serialNumber << "is not valid";
         return std::nullopt;
     }
 
-    // Build and return the pose
-    return [&pose]() -> const Pose {
-        Pose out;
-        out.position = {
-            pose.mDeviceToAbsoluteTracking.m[0][3],
-            pose.mDeviceToAbsoluteTracking.m[1][3],
-            pose.mDeviceToAbsoluteTracking.m[2][3],
-        };
-        out.rotationRowMajor = {
-            pose.mDeviceToAbsoluteTracking.m[0][0],
-            pose.mDeviceToAbsoluteTracking.m[0][1],
-            pose.mDeviceToAbsoluteTracking.m[0][2],
-            pose.mDeviceToAbsoluteTracking.m[1][0],
-            pose.mDeviceToAbsoluteTracking.m[1][1],
-            pose.mDeviceToAbsoluteTracking.m[1][2],
-            pose.mDeviceToAbsoluteTracking.m[2][0],
-            pose.mDeviceToAbsoluteTracking.m[2][1],
-            pose.mDeviceToAbsoluteTracking.m[2][2],
-        };
-        return out;
-    }();
+    return sample.pose;
+}
+
+bool openvr::DevicesManager::snapshot(DevicesSnapshot& snapshot) const
+{
+    snapshot.size = 0;
+
+    if (!this->initialized()) {
+        yError() << "Failed to read data from the runtime, the manager is "
+                 << "not initialized";
+        return false;
+    }
+
+    pImpl->loadSnapshot(snapshot);
+    return true;
+}
+
+bool openvr::DevicesManager::setPrediction(const PredictionMode mode,
+                                           const double horizon)
+{
+    if (!(horizon >= 0)) {
+        yError() << "Invalid prediction horizon" << horizon;
+        return false;
+    }
+
+    const auto lock = std::unique_lock(pImpl->mutex);
+
+    pImpl->predictionMode = mode;
+    pImpl->predictionHorizon = horizon;
+    return true;
+}
+
+openvr::PredictionMode openvr::DevicesManager::predictionMode() const
+{
+    const auto lock = std::unique_lock(pImpl->mutex);
+    return pImpl->predictionMode;
+}
+
+double openvr::DevicesManager::predictionHorizon() const
+{
+    const auto lock = std::unique_lock(pImpl->mutex);
+    return pImpl->predictionHorizon;
+}
+
+bool openvr::DevicesManager::setUniverseTransform(const Transform& transform)
+{
+    const auto lock = std::unique_lock(pImpl->mutex);
+    pImpl->universeTransform = transform;
+    return true;
+}
+
+openvr::Transform openvr::DevicesManager::universeTransform() const
+{
+    const auto lock = std::unique_lock(pImpl->mutex);
+    return pImpl->universeTransform;
+}
+
+openvr::LatencyHistogram::Statistics
+openvr::DevicesManager::computePosesStatistics() const
+{
+    return pImpl->computePosesDurations.statistics();
+}
+
+void openvr::DevicesManager::resetStatistics()
+{
+    pImpl->computePosesDurations.reset();
+}
+
+bool openvr::DevicesManager::startAcquisition(const double period)
+{
+    // While connecting, poses are computed once the runtime is attached
+    if (!this->initialized() && !pImpl->reconnect) {
+        yError() << "Failed to start the acquisition, the manager is "
+                 << "not initialized";
+        return false;
+    }
+
+    if (!(period > 0)) {
+        yError() << "Invalid acquisition period" << period;
+        return false;
+    }
+
+    if (pImpl->acquiring.exchange(true)) {
+        yError() << "The acquisition is already running";
+        return false;
+    }
+
+    // Create the acquisition thread
+    auto acquisitionLoop = [this, period]() {
+        yDebug() << "Acquisition thread: starting";
+
+        const auto step = std::chrono::duration_cast<
+            std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(period));
+        auto next = std::chrono::steady_clock::now();
+
+        while (pImpl->acquiring) {
+            // Devices connected since the last tick are acquired right away
+            if (this->initialized()) {
+                this->processEvents();
+            }
+
+            pImpl->computePoses();
+
+            // Do not try to catch up if an iteration overran the period
+            next = std::max(next + step, std::chrono::steady_clock::now());
+            std::this_thread::sleep_until(next);
+        }
+
+        yDebug() << "Acquisition thread: exiting";
+    };
+
+    pImpl->acquisition = std::thread(acquisitionLoop);
+
+    yInfo() << "Acquiring poses every" << period << "s";
+    return true;
+}
+
+void openvr::DevicesManager::stopAcquisition()
+{
+    pImpl->acquiring = false;
+
+    if (pImpl->acquisition.joinable()) {
+        pImpl->acquisition.join();
+    }
+}
+
+bool openvr::DevicesManager::latestSnapshot(DevicesSnapshot& snapshot) const
+{
+    snapshot.size = 0;
+
+    // No poses have been computed yet
+    if (pImpl->samples.version() == 0) {
+        return false;
+    }
+
+    pImpl->loadSnapshot(snapshot);
+    return true;
 }
 
 bool openvr::DevicesManager::resetSeatedPosition()
@@ -372,7 +1442,16 @@ bool openvr::DevicesManager::resetSeatedPosition()
 
     const auto lock = std::unique_lock(pImpl->mutex);
 
-    vr::VRChaperone()->ResetZeroPose(vr::ETrackingUniverseOrigin::TrackingUniverseSeated);
+    // The runtime could have been detached meanwhile, detach() shuts it down
+    // holding the mutex
+    if (!pImpl->attached) {
+        yError() << "Failed to reset the seated position, the runtime was "
+                 << "detached";
+        return false;
+    }
+
+    pImpl->runtime()->resetZeroPose(
+        vr::ETrackingUniverseOrigin::TrackingUniverseSeated);
 
     return true;
 }
@@ -381,13 +1460,141 @@ bool openvr::DevicesManager::resetSeatedPosition()
 // Private methods
 // ===============
 
+bool openvr::DevicesManager::attach()
+{
+    const auto lock = std::scoped_lock(pImpl->devicesMutex, pImpl->mutex);
+
+    if (pImpl->closing) {
+        return false;
+    }
+
+    if (!pImpl->hasBackend() || !pImpl->runtime()->initialize()) {
+        yError() << "Failed to initialize the tracking backend";
+        return false;
+    }
+
+    pImpl->attached = true;
+
+    yDebug() << "OpenVR runtime correctly started";
+
+    // Pending events refer to devices that are found by the scan
+    this->clearEvents();
+
+    yDebug() << "Scanning for existing devices";
+
+    // Add all the connected devices with supported types
+    for (size_t index = 0; index < MaxTrackedDevices; ++index) {
+        if (!pImpl->runtime()->isTrackedDeviceConnected(index)) {
+            continue;
+        }
+
+        yDebug() << "Inserting device with index" << index;
+
+        if (!this->addDevice(index)) {
+            yError() << "Failed to add device with index" << index;
+            this->detach();
+            return false;
+        }
+    }
+
+    pImpl->attachments++;
+    return true;
+}
+
+void openvr::DevicesManager::detach()
+{
+    const auto lock = std::scoped_lock(pImpl->devicesMutex, pImpl->mutex);
+
+    if (!pImpl->attached) {
+        return;
+    }
+
+    // Remove all the tracked devices
+    for (const auto& serial : this->managedDevices()) {
+        if (!this->removeDevice(serial)) {
+            yWarning() << "Failed to remove device with serial" << serial;
+        }
+    }
+
+    // Shutdown the runtime
+    pImpl->attached = false;
+    pImpl->runtime()->shutdown();
+
+    // Readers of the latest poses see no devices until the runtime is
+    // attached again
+    pImpl->states = {};
+    pImpl->publishSamples(pImpl->currentDevices());
+}
+
+void openvr::DevicesManager::checkRuntime()
+{
+    const auto lock = std::scoped_lock(pImpl->devicesMutex, pImpl->mutex);
+
+    // Detach from runtimes that stopped without sending a Quit event
+    if (pImpl->attached && !pImpl->runtime()->running()) {
+        yError() << "The VR runtime is not running anymore";
+        this->detach();
+    }
+}
+
+void openvr::DevicesManager::runDetector()
+{
+    yDebug() << "Detector thread: starting";
+
+    using Clock = std::chrono::steady_clock;
+    const auto seconds = [](const double value) {
+        return std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(value));
+    };
+
+    // The first attempt is immediate. After a detach, the runtime is given
+    // the minimum delay to restart.
+    bool wasAttached = false;
+    double delay = pImpl->minReconnectionDelay;
+    auto nextAttempt = Clock::now();
+
+    while (!pImpl->closing && (this->initialized() || pImpl->reconnect)) {
+
+        if (this->initialized()) {
+            wasAttached = true;
+            this->checkRuntime();
+
+            // Events are processed by the acquisition thread while it runs
+            if (!pImpl->acquiring && this->initialized()) {
+                this->processEvents();
+            }
+        }
+        else if (wasAttached) {
+            wasAttached = false;
+            delay = pImpl->minReconnectionDelay;
+            nextAttempt = Clock::now() + seconds(delay);
+        }
+        else if (Clock::now() >= nextAttempt) {
+            if (this->attach()) {
+                yInfo() << "VR runtime attached";
+                delay = pImpl->minReconnectionDelay;
+            }
+            else {
+                yInfo() << "Retrying to attach the VR runtime in" << delay
+                        << "s";
+                nextAttempt = Clock::now() + seconds(delay);
+                delay = std::min(2 * delay, pImpl->maxReconnectionDelay.load());
+            }
+        }
+
+        std::this_thread::sleep_for(seconds(pImpl->eventsPeriod));
+    }
+
+    yDebug() << "Detector thread: exiting";
+}
+
 void openvr::DevicesManager::clearEvents()
 {
     size_t number = 0;
     vr::VREvent_t event;
-    const auto lock = std::unique_lock(pImpl->mutex);
+    const auto lock = std::unique_lock(pImpl->devicesMutex);
 
-    while (pImpl->vr->PollNextEvent(&event, sizeof(event))) {
+    while (pImpl->runtime()->pollNextEvent(event)) {
         number++;
     }
 
@@ -397,18 +1604,17 @@ void openvr::DevicesManager::clearEvents()
 void openvr::DevicesManager::processEvents()
 {
     vr::VREvent_t event;
-    const auto lock = std::unique_lock(pImpl->mutex);
+    const auto lock = std::unique_lock(pImpl->devicesMutex);
 
     if (!this->initialized()) {
         yError() << "Manager not initialized";
         return;
     }
 
-    while (pImpl->vr->PollNextEvent(&event, sizeof(event))) {
+    while (pImpl->runtime()->pollNextEvent(event)) {
 
         // yDebug() << "Received event:"
-        //          << pImpl->vr->GetEventTypeNameFromEnum(
-        //                 vr::EVREventType(event.eventType));
+        //          << vr::EVREventType(event.eventType);
         // yDebug() << event.trackedDeviceIndex;
 
         switch (event.eventType) {
@@ -417,32 +1623,41 @@ void openvr::DevicesManager::processEvents()
                 break;
             }
             case vr::VREvent_TrackedDeviceDeactivated: {
-                for (const auto& [sn, device] : pImpl->devices) {
-                    if (device.index == event.trackedDeviceIndex)
-                        this->removeDevice(sn);
+                const size_t slot = event.trackedDeviceIndex;
+                const Impl::DevicesSet& devices = pImpl->currentDevices();
+                if (slot < MaxTrackedDevices && devices.managed[slot]) {
+                    this->removeDevice(
+                        std::string(devices.serialNumber[slot]));
+                }
+                break;
+            }
+            case vr::VREvent_TrackedDeviceUpdated: {
+                this->updateDevice(event.trackedDeviceIndex);
+                break;
+            }
+            case vr::VREvent_TrackedDeviceRoleChanged: {
+                // Roles can be swapped between devices, and devices not
+                // managed could now be selected
+                for (size_t index = 0; index < MaxTrackedDevices; ++index) {
+                    if (pImpl->currentDevices().managed[index]) {
+                        this->updateDevice(index);
+                    }
+                    else if (pImpl->runtime()->isTrackedDeviceConnected(
+                                 index)) {
+                        this->addDevice(index);
+                    }
                 }
                 break;
             }
-            case vr::VREvent_TrackedDeviceUpdated:
-            case vr::VREvent_TrackedDeviceRoleChanged:
             case vr::VREvent_TrackedDeviceUserInteractionStarted:
             case vr::VREvent_TrackedDeviceUserInteractionEnded:
                 break;
             case vr::VREvent_Quit: {
                 // Notify we need to do some work before quitting
-                pImpl->vr->AcknowledgeQuit_Exiting();
-
-                // Remove all the tracked devices
-                for (const auto& serial : this->managedDevices()) {
-                    if (!this->removeDevice(serial)) {
-                        yWarning()
-                            << "Failed to remove device with serial" << serial;
-                    }
-                }
+                pImpl->runtime()->acknowledgeQuit();
 
-                // Shutdown the runtime
-                pImpl->vr = nullptr;
-                vr::VR_Shutdown();
+                yWarning() << "The VR runtime is quitting";
+                this->detach();
                 break;
             }
             default:
@@ -451,7 +1666,7 @@ void openvr::DevicesManager::processEvents()
 
         // Break early when attempting to process events after
         // the Quit event has been received
-        if (!pImpl->vr) {
+        if (!pImpl->attached) {
             break;
         }
     }
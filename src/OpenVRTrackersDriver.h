@@ -11,16 +11,25 @@
 #ifndef OPENVR_TRACKERS_DRIVER_H
 #define OPENVR_TRACKERS_DRIVER_H
 
+#include "LatencyHistogram.h"
+
 #include <array>
 #include <memory>
 #include <optional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace openvr {
     struct Pose;
+    struct Transform;
     struct TrackedDevice;
+    struct DeviceState;
+    struct DeviceProperties;
+    struct DevicesSnapshot;
+    struct DeviceSelection;
     class DevicesManager;
+    class TrackingBackend;
 
     enum class TrackingUniverseOrigin
     {
@@ -38,12 +47,60 @@ namespace openvr {
         TrackingReference = 4,
         DisplayRedirect = 5,
     };
+
+    // Same values of vr::ETrackingResult
+    enum class TrackingResult
+    {
+        Uninitialized = 1,
+        CalibratingInProgress = 100,
+        CalibratingOutOfRange = 101,
+        RunningOK = 200,
+        RunningOutOfRange = 201,
+        FallbackRotationOnly = 300,
+    };
+
+    enum class PredictionMode
+    {
+        // Prediction of the runtime, the horizon is relative to the time
+        // the poses are computed
+        Runtime = 0,
+        // Prediction of the runtime, the horizon is relative to the last
+        // vsync of the display
+        RuntimeVsync = 1,
+        // Extrapolation of the poses returned by the runtime assuming
+        // constant linear and angular velocity
+        ConstantVelocity = 2,
+        // Extrapolation of the poses returned by the runtime assuming
+        // constant linear and angular acceleration
+        ConstantAcceleration = 3,
+    };
+
+    // Maximum number of devices handled by the runtime
+    // (vr::k_unMaxTrackedDeviceCount)
+    constexpr size_t MaxTrackedDevices = 64;
+
+    // Name of the type replacing the {type} placeholder of the frame names:
+    // "hmd", "controllers" or "trackers", empty for the other types
+    std::string TrackedDeviceTypeName(const TrackedDeviceType type);
 } // namespace openvr
 
 struct openvr::Pose
 {
     std::array<double, 3> position;
     std::array<double, 9> rotationRowMajor;
+    // Unit quaternion of rotationRowMajor in (w, x, y, z) order
+    std::array<double, 4> quaternion;
+    // Velocities expressed in the tracking universe frame
+    std::array<double, 3> linearVelocity;
+    std::array<double, 3> angularVelocity;
+    TrackingResult trackingResult = TrackingResult::Uninitialized;
+};
+
+// Rigid transform, the identity by default
+struct openvr::Transform
+{
+    std::array<double, 3> position = {0, 0, 0};
+    std::array<double, 9> rotationRowMajor = {1, 0, 0, 0, 1, 0, 0, 0, 1};
 };
 
 struct openvr::TrackedDevice
@@ -53,23 +110,174 @@ struct openvr::TrackedDevice
     TrackedDeviceType type = TrackedDeviceType::Invalid;
 };
 
+/**
+ * Properties of a device cached by the DevicesManager.
+ */
+struct openvr::DeviceProperties
+{
+    std::string serialNumber;
+    std::string modelNumber;
+    std::string controllerType;
+    std::string firmwareVersion;
+    // See DevicesManager::role()
+    std::string role;
+    bool wireless = false;
+    bool charging = false;
+    // Charge of wireless devices in [0, 1]
+    float batteryLevel = 0;
+};
+
+struct openvr::DeviceState
+{
+    size_t index = 0;
+    std::string serialNumber;
+    std::string frameName;
+    TrackedDeviceType type = TrackedDeviceType::Invalid;
+    bool valid = false;
+    Pose pose;
+    // Time the last valid pose of the device refers to, including the
+    // prediction, expressed with the clock of yarp::os::Time::now() [s]
+    double timestamp = 0;
+};
+
+/**
+ * Caller-owned storage filled by DevicesManager::snapshot().
+ *
+ * Only the first `size` elements of `devices` are meaningful. The storage
+ * is reused across calls, so that after the first call no allocation occurs.
+ */
+struct openvr::DevicesSnapshot
+{
+    // Time the poses computed last refer to, including the prediction [s]
+    double timestamp = 0;
+    // Time the poses were fetched from the runtime [s]
+    double acquisitionTimestamp = 0;
+
+    size_t size = 0;
+    std::array<DeviceState, MaxTrackedDevices> devices;
+};
+
+/**
+ * Subset of the devices handled by a DevicesManager.
+ *
+ * A device is selected if it matches all the non-empty lists.
+ */
+struct openvr::DeviceSelection
+{
+    std::vector<std::string> serialNumbers;
+    std::vector<TrackedDeviceType> types;
+    // Roles as returned by DevicesManager::role()
+    std::vector<std::string> roles;
+
+    bool selects(const std::string& serialNumber,
+                 const TrackedDeviceType type,
+                 const std::string& role) const;
+};
+
 class openvr::DevicesManager
 {
 public:
     DevicesManager();
+    explicit DevicesManager(std::unique_ptr<TrackingBackend> backend);
     ~DevicesManager();
 
     bool valid() const;
     bool initialize(const TrackingUniverseOrigin& vrOrigin = TrackingUniverseOrigin::Seated);
     bool initialized() const;
 
+    // Attach the runtime in background. Unlike initialize(), it returns
+    // immediately: the runtime is attached as soon as it is running, and
+    // attached again after it quits or stops running. Failed attempts are
+    // retried with an exponential backoff between the given delays [s].
+    bool connect(const TrackingUniverseOrigin& vrOrigin = TrackingUniverseOrigin::Seated);
+    bool setReconnectionDelays(const double minDelay, const double maxDelay);
+
+    // Number of times the runtime has been attached. Devices are added
+    // again, and the seated zero pose is the one of the new runtime.
+    size_t attachments() const;
+
+    // Change the origin of the tracking universe of the poses. It applies
+    // from the next computation of the poses, also after reattaching.
+    bool setTrackingUniverseOrigin(const TrackingUniverseOrigin& vrOrigin);
+    TrackingUniverseOrigin trackingUniverseOrigin() const;
+
+    // Set the interval between the polls of the runtime events (e.g. the
+    // connection of a device). While the acquisition thread is running, the
+    // events are instead polled at every acquisition.
+    bool setEventsPeriod(const double period);
+    double eventsPeriod() const;
+
     bool addDevice(const size_t index);
     bool removeDevice(const std::string& serialNumber);
     std::vector<std::string> managedDevices() const;
 
+    // Restrict the managed devices. Devices not selected anymore are
+    // removed, and the connected devices that become selected are added.
+    bool setDeviceSelection(const DeviceSelection& selection);
+    DeviceSelection deviceSelection() const;
+
+    // Set how the frame names of the devices are computed. The template can
+    // contain the {serial}, {type} (hmd, controllers, trackers), {index} and
+    // {role} placeholders. Devices whose serial is a key of `names` use the
+    // associated name instead. Names are resolved when devices are added,
+    // and again when their role changes.
+    bool setFrameNaming(const std::string& nameTemplate,
+                        const std::unordered_map<std::string, std::string>&
+                            names = {});
+    std::string frameName(const std::string& serialNumber) const;
+
+    // Set fixed transforms from the frame of the devices to the frame of
+    // their published poses, e.g. to align trackers with different roles.
+    // Keys are serial numbers or roles, serial numbers take precedence.
+    // Offsets are resolved when devices are added or change role, and are
+    // applied to the poses of all the devices in a single pass.
+    bool setFrameOffsets(
+        const std::unordered_map<std::string, Transform>& offsets);
+    std::optional<Transform> frameOffset(const std::string& serialNumber) const;
+
+    // Set a fixed transform from the tracking universe to the frame the
+    // poses are expressed in, e.g. computed by a calibration. It is applied
+    // in the same pass of the frame offsets.
+    bool setUniverseTransform(const Transform& transform);
+    Transform universeTransform() const;
+
     TrackedDeviceType type(const std::string& serialNumber) const;
+
+    // Role of the device: "head" for HMDs, "left_hand" or "right_hand" for
+    // controllers, and the role assigned in SteamVR for trackers (e.g.
+    // "left_foot", "handed"). Empty if the device has no role.
+    std::string role(const std::string& serialNumber) const;
+
+    // Properties read from the runtime when the device was added, and read
+    // again only when the runtime reports that the device was updated or
+    // that the roles changed. Like role(), no calls to the runtime are made.
+    // Empty if the device is not managed, e.g. removed after a snapshot,
+    // which is not an error.
+    std::optional<DeviceProperties>
+    properties(const std::string& serialNumber) const;
+
     bool computePoses();
+    bool setPrediction(const PredictionMode mode, const double horizon);
+    PredictionMode predictionMode() const;
+    double predictionHorizon() const;
+
+    // Read the state produced by the last computePoses(). Like
+    // initialized(), managedDevices(), frameName() and type(), these methods
+    // take no locks and never wait for the processing of the events or for
+    // the computation of the poses.
     std::optional<Pose> pose(const std::string& serialNumber) const;
+    bool snapshot(DevicesSnapshot& snapshot) const;
+
+    // Compute the poses in a dedicated thread. The most recent poses can be
+    // read without blocking with latestSnapshot().
+    bool startAcquisition(const double period);
+    void stopAcquisition();
+    bool latestSnapshot(DevicesSnapshot& snapshot) const;
+
+    // Statistics of the duration of the computation of the poses, either
+    // called by the user or by the acquisition thread
+    LatencyHistogram::Statistics computePosesStatistics() const;
+    void resetStatistics();
 
     bool resetSeatedPosition();
 
@@ -77,6 +285,11 @@ private:
     class Impl;
     std::unique_ptr<Impl> pImpl;
 
+    bool attach();
+    void detach();
+    bool updateDevice(const size_t index);
+    void checkRuntime();
+    void runDetector();
     void clearEvents();
     void processEvents();
 };
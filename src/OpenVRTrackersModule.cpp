@@ -9,7 +9,19 @@
  */
 
 #include "OpenVRTrackersModule.h"
+#include "OpenVRBackend.h"
+#include "ReplayBackend.h"
+#include "Rotations.h"
+#include "SimulatedBackend.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <yarp/os/Property.h>
 #include <yarp/os/LogStream.h>
+#include <yarp/os/Network.h>
+#include <yarp/os/Time.h>
 
 namespace openvr_trackers_module {
     constexpr double DefaultPeriod = 0.010;
@@ -19,6 +31,235 @@ namespace openvr_trackers_module {
     const std::string ModuleName = "OpenVRTrackersModule";
     const std::string LogPrefix = ModuleName + ":";
     const std::string DefaultVrOrigin = "Seated";
+    const std::string DefaultBackend = "openvr";
+    const std::string DefaultFrameNameTemplate = "/{type}/{serial}";
+    const std::string FrameNamesGroup = "FRAME_NAMES";
+    const std::string FilterGroup = "FILTER";
+    const std::string FrameOffsetsGroup = "FRAME_OFFSETS";
+    const std::string DefaultPredictionMode = "runtime";
+    const std::string StatePortSuffix = "/state:o";
+    const std::string TransformsPortSuffix = "/transforms:o";
+    const std::string PosesPortSuffix = "/poses:o";
+    const std::string StatsPortSuffix = "/stats:o";
+    const std::string CalibrationPortSuffix = "/calibration:i";
+    const std::string CalibrationTfPortSuffix = "/calibrationTf:i";
+    const std::string TfStreamPortSuffix = "/transforms:o";
+    const std::string RpcPortSuffix = "/rpc";
+    constexpr double StatsPublishPeriod = 1.0;
+    const std::vector<std::string> LatencyMeasures = {
+        "computePoses", "snapshot", "publish", "age", "period"};
+    constexpr double DefaultPredictionHorizon = 0.0;
+    constexpr double DefaultEventsPeriod = 0.1;
+    constexpr double DefaultReconnectionDelay = 0.5;
+    constexpr double DefaultMaxReconnectionDelay = 5.0;
+    constexpr double DefaultReplaySpeed = 1.0;
+
+    // Consecutive calibration samples closer than this distance [m] are
+    // discarded, so that the tracker standing still does not outweigh the
+    // rest of the trajectory
+    constexpr double CalibrationMinDistance = 0.005;
+
+    // Maximum difference between the time of a stamped reference position
+    // and the time of the pose of the tracker [s]
+    constexpr double CalibrationMaxTimeOffset = 0.02;
+
+    std::string ToLower(std::string text)
+    {
+        std::transform(text.begin(), text.end(), text.begin(),
+                       [](unsigned char c) { return std::tolower(c); });
+        return text;
+    }
+
+    // A flag is enabled when its key is given alone or set to true
+    bool ParseFlag(const yarp::os::ResourceFinder& rf, const std::string& key)
+    {
+        return rf.check(key)
+               && (rf.find(key).isNull()
+                   || (rf.find(key).isBool() && rf.find(key).asBool()));
+    }
+
+    std::optional<openvr::PredictionMode>
+    PredictionModeFromString(const std::string& text)
+    {
+        const std::string mode = ToLower(text);
+
+        if (mode == "runtime") {
+            return openvr::PredictionMode::Runtime;
+        }
+        if (mode == "vsync") {
+            return openvr::PredictionMode::RuntimeVsync;
+        }
+        if (mode == "velocity") {
+            return openvr::PredictionMode::ConstantVelocity;
+        }
+        if (mode == "acceleration") {
+            return openvr::PredictionMode::ConstantAcceleration;
+        }
+        return std::nullopt;
+    }
+
+    // Inverse of openvr::TrackedDeviceTypeName()
+    std::optional<openvr::TrackedDeviceType>
+    TrackedDeviceTypeFromString(const std::string& type)
+    {
+        for (const auto candidate :
+             {openvr::TrackedDeviceType::HMD,
+              openvr::TrackedDeviceType::Controller,
+              openvr::TrackedDeviceType::GenericTracker}) {
+            if (openvr::TrackedDeviceTypeName(candidate) == type) {
+                return candidate;
+            }
+        }
+        return std::nullopt;
+    }
+
+    std::optional<openvr::TrackingUniverseOrigin>
+    TrackingUniverseOriginFromString(const std::string& text)
+    {
+        const std::string origin = ToLower(text);
+
+        if (origin == "seated") {
+            return openvr::TrackingUniverseOrigin::Seated;
+        }
+        if (origin == "standing") {
+            return openvr::TrackingUniverseOrigin::Standing;
+        }
+        if (origin == "raw") {
+            return openvr::TrackingUniverseOrigin::Raw;
+        }
+        return std::nullopt;
+    }
+
+    std::string
+    TrackingUniverseOriginToString(const openvr::TrackingUniverseOrigin origin)
+    {
+        switch (origin) {
+            case openvr::TrackingUniverseOrigin::Seated:
+                return "seated";
+            case openvr::TrackingUniverseOrigin::Standing:
+                return "standing";
+            case openvr::TrackingUniverseOrigin::Raw:
+                return "raw";
+        }
+        return "";
+    }
+
+    std::string TrackingResultToString(const openvr::TrackingResult result)
+    {
+        switch (result) {
+            case openvr::TrackingResult::Uninitialized:
+                return "uninitialized";
+            case openvr::TrackingResult::CalibratingInProgress:
+                return "calibrating";
+            case openvr::TrackingResult::CalibratingOutOfRange:
+                return "calibratingOutOfRange";
+            case openvr::TrackingResult::RunningOK:
+                return "ok";
+            case openvr::TrackingResult::RunningOutOfRange:
+                return "outOfRange";
+            case openvr::TrackingResult::FallbackRotationOnly:
+                return "rotationOnly";
+        }
+        return "";
+    }
+
+    // Parse a line of the FILTER group in the form
+    // "<device type> <filter> [parameters]"
+    std::optional<openvr::FilterParameters>
+    FilterParametersFromBottle(const yarp::os::Bottle& entry)
+    {
+        openvr::FilterParameters parameters;
+
+        const std::string filter = ToLower(entry.get(1).asString());
+
+        std::vector<double*> values;
+        if (filter == "none") {
+            parameters.type = openvr::FilterType::None;
+        }
+        else if (filter == "exponential") {
+            parameters.type = openvr::FilterType::Exponential;
+            values = {&parameters.timeConstant};
+        }
+        else if (filter == "oneeuro") {
+            parameters.type = openvr::FilterType::OneEuro;
+            values = {&parameters.minCutoff,
+                      &parameters.beta,
+                      &parameters.derivativeCutoff};
+        }
+        else if (filter == "kalman") {
+            parameters.type = openvr::FilterType::Kalman;
+            values = {&parameters.processNoise, &parameters.measurementNoise};
+        }
+        else {
+            return std::nullopt;
+        }
+
+        // Missing parameters keep their default value
+        if (entry.size() > 2 + values.size()) {
+            return std::nullopt;
+        }
+
+        for (size_t i = 2; i < entry.size(); ++i) {
+            if (!(entry.get(i).isFloat64() || entry.get(i).isInt32())
+                || entry.get(i).asFloat64() < 0) {
+                return std::nullopt;
+            }
+            *values[i - 2] = entry.get(i).asFloat64();
+        }
+
+        return parameters;
+    }
+
+    // Parse a line of the FRAME_OFFSETS group in the form
+    // "<serial|role> x y z roll pitch yaw", with the position in meters and
+    // the rotation Rz(yaw) * Ry(pitch) * Rx(roll) in degrees
+    std::optional<openvr::Transform>
+    TransformFromBottle(const yarp::os::Bottle& entry)
+    {
+        if (entry.size() != 7) {
+            return std::nullopt;
+        }
+
+        double values[6];
+        for (size_t i = 0; i < 6; ++i) {
+            if (!(entry.get(i + 1).isFloat64() || entry.get(i + 1).isInt32())) {
+                return std::nullopt;
+            }
+            values[i] = entry.get(i + 1).asFloat64();
+        }
+
+        constexpr double DegreesToRadians = 3.141592653589793 / 180;
+        const double cr = std::cos(values[3] * DegreesToRadians);
+        const double sr = std::sin(values[3] * DegreesToRadians);
+        const double cp = std::cos(values[4] * DegreesToRadians);
+        const double sp = std::sin(values[4] * DegreesToRadians);
+        const double cy = std::cos(values[5] * DegreesToRadians);
+        const double sy = std::sin(values[5] * DegreesToRadians);
+
+        openvr::Transform transform;
+        transform.position = {values[0], values[1], values[2]};
+        transform.rotationRowMajor = {
+            cy * cp, cy * sp * sr - sy * cr, cy * sp * cr + sy * sr,
+            sy * cp, sy * sp * sr + cy * cr, sy * sp * cr - cy * sr,
+            -sp,     cp * sr,                cp * cr,
+        };
+        return transform;
+    }
+
+    std::string PredictionModeToString(const openvr::PredictionMode mode)
+    {
+        switch (mode) {
+            case openvr::PredictionMode::Runtime:
+                return "runtime";
+            case openvr::PredictionMode::RuntimeVsync:
+                return "vsync";
+            case openvr::PredictionMode::ConstantVelocity:
+                return "velocity";
+            case openvr::PredictionMode::ConstantAcceleration:
+                return "acceleration";
+        }
+        return "";
+    }
 } // namespace openvr_trackers_module
 
 bool OpenVRTrackersModule::configure(yarp::os::ResourceFinder& rf)
@@ -53,6 +294,43 @@ bool OpenVRTrackersModule::configure(yarp::os::ResourceFinder& rf)
         m_period = rf.find("period").asFloat64();
     }
 
+    // Try to find the "acquisitionPeriod" entry. If set, the poses are
+    // acquired by a dedicated thread of the manager at the given period
+    // and the module publishes the most recent ones.
+    m_acquisitionPeriod = 0;
+    if (rf.check("acquisitionPeriod")
+        && rf.find("acquisitionPeriod").isFloat64()) {
+        m_acquisitionPeriod = rf.find("acquisitionPeriod").asFloat64();
+        yInfo() << openvr_trackers_module::LogPrefix
+                << "Using acquisition thread with period:"
+                << m_acquisitionPeriod << "s";
+    }
+
+    // Try to find the "publishState" entry. If set, the full kinematic
+    // state of all the devices is streamed on the "/<name>/state:o" port.
+    m_publishState = openvr_trackers_module::ParseFlag(rf, "publishState");
+
+    // Try to find the "stateQuaternion" entry. If set, the state stream
+    // contains the orientation quaternion instead of the rotation matrix.
+    m_publication.stateQuaternion =
+        openvr_trackers_module::ParseFlag(rf, "stateQuaternion");
+
+    // Try to find the "batchedTransforms" entry. If set, all the transforms
+    // of a cycle are written as a single message on the
+    // "/<name>/transforms:o" port instead of being sent one by one to the
+    // transformServer.
+    m_batchedTransforms =
+        openvr_trackers_module::ParseFlag(rf, "batchedTransforms");
+
+    // Try to find the "publishPoses" entry. If set, the state of all the
+    // devices is also streamed in binary format on the "/<name>/poses:o"
+    // port, which consumers can read directly bypassing the transformServer.
+    m_publishPoses = openvr_trackers_module::ParseFlag(rf, "publishPoses");
+
+    // Try to find the "publishStats" entry. If set, the latency statistics
+    // are streamed on the "/<name>/stats:o" port every second.
+    m_publishStats = openvr_trackers_module::ParseFlag(rf, "publishStats");
+
     // Try to find the "tfBaseFrameName" entry
     if (!(rf.check("tfBaseFrameName")
           && rf.find("tfBaseFrameName").isString())) {
@@ -64,6 +342,7 @@ bool OpenVRTrackersModule::configure(yarp::os::ResourceFinder& rf)
     else {
         m_baseFrame = rf.find("tfBaseFrameName").asString();
     }
+    m_publication.baseFrame = m_baseFrame;
 
     // Try to find the "tfLocal" entry
     std::string tfLocal;
@@ -87,6 +366,16 @@ bool OpenVRTrackersModule::configure(yarp::os::ResourceFinder& rf)
     else {
         tfRemote = rf.find("tfRemote").asString();
     }
+    m_tfStream = tfRemote + openvr_trackers_module::TfStreamPortSuffix;
+
+    // Try to find the "calibrationWorldFrame" entry. The reference frames of
+    // the calibration are read with respect to this frame, and the
+    // calibration with reference frames is disabled when it is not set.
+    m_calibrationWorldFrame.clear();
+    if (rf.check("calibrationWorldFrame")
+        && rf.find("calibrationWorldFrame").isString()) {
+        m_calibrationWorldFrame = rf.find("calibrationWorldFrame").asString();
+    }
 
     // Try to find the "vrOrigin" entry
     std::string vrOriginString;
@@ -99,15 +388,10 @@ bool OpenVRTrackersModule::configure(yarp::os::ResourceFinder& rf)
     }
     else {
         vrOriginString = rf.find("vrOrigin").asString();
-        std::transform(vrOriginString.begin(), vrOriginString.end(), vrOriginString.begin(), [](unsigned char c){ return std::tolower(c); });
-        if(vrOriginString == "seated") {
-            vrOrigin = openvr::TrackingUniverseOrigin::Seated;
-        }
-        else if(vrOriginString == "standing") {
-            vrOrigin = openvr::TrackingUniverseOrigin::Standing;
-        }
-        else if(vrOriginString == "raw") {
-            vrOrigin = openvr::TrackingUniverseOrigin::Raw;
+        if (const auto origin =
+                openvr_trackers_module::TrackingUniverseOriginFromString(
+                    vrOriginString)) {
+            vrOrigin = *origin;
         }
         else {
             vrOrigin = openvr::TrackingUniverseOrigin::Seated;
@@ -116,7 +400,399 @@ bool OpenVRTrackersModule::configure(yarp::os::ResourceFinder& rf)
         }
     }
 
-    // Create configuration of the "transformClient" device
+    // Try to find the "backend" entry
+    std::string backend;
+    if (!(rf.check("backend") && rf.find("backend").isString())) {
+        yInfo() << openvr_trackers_module::LogPrefix
+                << "Using default backend:"
+                << openvr_trackers_module::DefaultBackend;
+        backend = openvr_trackers_module::DefaultBackend;
+    }
+    else {
+        backend = openvr_trackers_module::ToLower(
+            rf.find("backend").asString());
+    }
+
+    if (backend == "openvr") {
+        m_manager = std::make_unique<openvr::DevicesManager>(
+            std::make_unique<openvr::OpenVRBackend>());
+    }
+    else if (backend == "simulated") {
+        // The number of simulated devices of each type can be configured
+        // with the "simulated{Hmds,TrackingReferences,Controllers,Trackers}"
+        // entries
+        openvr::SimulatedBackend::Options options;
+        options.clock = openvr::SimulatedBackend::Clock::WallClock;
+
+        const auto readCount = [&](const std::string& key, size_t& count) {
+            if (rf.check(key) && rf.find(key).isInt32()) {
+                count = size_t(std::max(0, rf.find(key).asInt32()));
+            }
+        };
+
+        readCount("simulatedHmds", options.hmds);
+        readCount("simulatedTrackingReferences", options.trackingReferences);
+        readCount("simulatedControllers", options.controllers);
+        readCount("simulatedTrackers", options.genericTrackers);
+
+        // Roles of the simulated trackers, e.g. "(left_foot right_foot)"
+        if (const yarp::os::Bottle* roles =
+                rf.find("simulatedTrackerRoles").asList()) {
+            for (size_t i = 0; i < roles->size(); ++i) {
+                options.trackerRoles.push_back(roles->get(i).toString());
+            }
+        }
+
+        yInfo() << openvr_trackers_module::LogPrefix
+                << "Using simulated backend with" << options.hmds << "HMDs,"
+                << options.trackingReferences << "tracking references,"
+                << options.controllers << "controllers and"
+                << options.genericTrackers << "trackers";
+
+        m_manager = std::make_unique<openvr::DevicesManager>(
+            std::make_unique<openvr::SimulatedBackend>(std::move(options)));
+    }
+    else if (backend == "replay") {
+        // The recording to replay is given by the "replayFile" entry, its
+        // speed by the "replaySpeed" entry (0 to replay it as fast as
+        // possible) and it restarts when it ends if "replayLoop" is set
+        openvr::ReplayBackend::Options options;
+
+        if (!(rf.check("replayFile") && rf.find("replayFile").isString())) {
+            yError() << openvr_trackers_module::LogPrefix
+                     << "The replay backend requires the replayFile entry";
+            return false;
+        }
+        options.path = rf.find("replayFile").asString();
+
+        if (!(rf.check("replaySpeed") && rf.find("replaySpeed").isFloat64())) {
+            yInfo() << openvr_trackers_module::LogPrefix
+                    << "Using default replaySpeed:"
+                    << openvr_trackers_module::DefaultReplaySpeed;
+            options.speed = openvr_trackers_module::DefaultReplaySpeed;
+        }
+        else {
+            options.speed = rf.find("replaySpeed").asFloat64();
+        }
+
+        if (options.speed < 0) {
+            yError() << openvr_trackers_module::LogPrefix
+                     << "Invalid replaySpeed value:" << options.speed;
+            return false;
+        }
+
+        options.loop = openvr_trackers_module::ParseFlag(rf, "replayLoop");
+
+        auto replay = std::make_unique<openvr::ReplayBackend>(options);
+        m_replay = replay.get();
+
+        m_manager = std::make_unique<openvr::DevicesManager>(std::move(replay));
+    }
+    else {
+        yError() << openvr_trackers_module::LogPrefix
+                 << "Invalid backend value:" << backend
+                 << "(supported: openvr, simulated, replay)";
+        return false;
+    }
+
+    // Try to find the "predictionMode" entry
+    std::string predictionModeString;
+    if (!(rf.check("predictionMode") && rf.find("predictionMode").isString())) {
+        yInfo() << openvr_trackers_module::LogPrefix
+                << "Using default predictionMode:"
+                << openvr_trackers_module::DefaultPredictionMode;
+        predictionModeString = openvr_trackers_module::DefaultPredictionMode;
+    }
+    else {
+        predictionModeString = rf.find("predictionMode").asString();
+    }
+
+    const auto predictionMode =
+        openvr_trackers_module::PredictionModeFromString(predictionModeString);
+
+    if (!predictionMode) {
+        yError() << openvr_trackers_module::LogPrefix
+                 << "Invalid predictionMode value:" << predictionModeString
+                 << "(supported: runtime, vsync, velocity, acceleration)";
+        return false;
+    }
+
+    // Try to find the "predictionHorizon" entry
+    double predictionHorizon;
+    if (!(rf.check("predictionHorizon")
+          && rf.find("predictionHorizon").isFloat64())) {
+        yInfo() << openvr_trackers_module::LogPrefix
+                << "Using default predictionHorizon:"
+                << openvr_trackers_module::DefaultPredictionHorizon << "s";
+        predictionHorizon = openvr_trackers_module::DefaultPredictionHorizon;
+    }
+    else {
+        predictionHorizon = rf.find("predictionHorizon").asFloat64();
+    }
+
+    if (!m_manager->setPrediction(predictionMode.value(), predictionHorizon)) {
+        yError() << openvr_trackers_module::LogPrefix
+                 << "Failed to set the prediction.";
+        return false;
+    }
+
+    // Try to find the "eventsPeriod" entry. It is not used when the
+    // acquisition thread is running, since it also processes the events.
+    double eventsPeriod;
+    if (!(rf.check("eventsPeriod") && rf.find("eventsPeriod").isFloat64())) {
+        yInfo() << openvr_trackers_module::LogPrefix
+                << "Using default eventsPeriod:"
+                << openvr_trackers_module::DefaultEventsPeriod << "s";
+        eventsPeriod = openvr_trackers_module::DefaultEventsPeriod;
+    }
+    else {
+        eventsPeriod = rf.find("eventsPeriod").asFloat64();
+    }
+
+    if (!m_manager->setEventsPeriod(eventsPeriod)) {
+        yError() << openvr_trackers_module::LogPrefix
+                 << "Failed to set the events period.";
+        return false;
+    }
+
+    // Try to find the "reconnectionDelay" and "maxReconnectionDelay"
+    // entries. The OpenVR runtime is attached in background, and the delay
+    // between failed attempts doubles up to the maximum one.
+    double reconnectionDelay;
+    if (!(rf.check("reconnectionDelay")
+          && rf.find("reconnectionDelay").isFloat64())) {
+        yInfo() << openvr_trackers_module::LogPrefix
+                << "Using default reconnectionDelay:"
+                << openvr_trackers_module::DefaultReconnectionDelay << "s";
+        reconnectionDelay = openvr_trackers_module::DefaultReconnectionDelay;
+    }
+    else {
+        reconnectionDelay = rf.find("reconnectionDelay").asFloat64();
+    }
+
+    double maxReconnectionDelay;
+    if (!(rf.check("maxReconnectionDelay")
+          && rf.find("maxReconnectionDelay").isFloat64())) {
+        yInfo() << openvr_trackers_module::LogPrefix
+                << "Using default maxReconnectionDelay:"
+                << openvr_trackers_module::DefaultMaxReconnectionDelay << "s";
+        maxReconnectionDelay =
+            std::max(reconnectionDelay,
+                     openvr_trackers_module::DefaultMaxReconnectionDelay);
+    }
+    else {
+        maxReconnectionDelay = rf.find("maxReconnectionDelay").asFloat64();
+    }
+
+    if (!m_manager->setReconnectionDelays(reconnectionDelay,
+                                          maxReconnectionDelay)) {
+        yError() << openvr_trackers_module::LogPrefix
+                 << "Failed to set the reconnection delays.";
+        return false;
+    }
+
+    if (m_batchedTransforms) {
+        // Open the port streaming all the transforms of a cycle
+        if (!m_transformsPort.open(
+                "/" + getName() + openvr_trackers_module::TransformsPortSuffix)) {
+            yError() << openvr_trackers_module::LogPrefix << "Could not open"
+                     << "/" + getName()
+                            + openvr_trackers_module::TransformsPortSuffix
+                     << "port.";
+            return false;
+        }
+    }
+
+    // Try to find the "frameNameTemplate" entry
+    std::string frameNameTemplate;
+    if (!(rf.check("frameNameTemplate")
+          && rf.find("frameNameTemplate").isString())) {
+        yInfo() << openvr_trackers_module::LogPrefix
+                << "Using default frameNameTemplate:"
+                << openvr_trackers_module::DefaultFrameNameTemplate;
+        frameNameTemplate = openvr_trackers_module::DefaultFrameNameTemplate;
+    }
+    else {
+        frameNameTemplate = rf.find("frameNameTemplate").asString();
+    }
+
+    // Try to find the "FRAME_NAMES" group, containing lines in the form
+    // "<serial> <frame name>" overriding the name of specific devices
+    std::unordered_map<std::string, std::string> frameNames;
+    if (const yarp::os::Bottle& group =
+            rf.findGroup(openvr_trackers_module::FrameNamesGroup);
+        !group.isNull()) {
+        // The first element is the name of the group
+        for (size_t i = 1; i < group.size(); ++i) {
+            const yarp::os::Bottle* entry = group.get(i).asList();
+
+            if (!(entry && entry->size() == 2 && entry->get(1).isString())) {
+                yError() << openvr_trackers_module::LogPrefix
+                         << "Invalid entry in the"
+                         << openvr_trackers_module::FrameNamesGroup
+                         << "group:" << group.get(i).toString();
+                return false;
+            }
+
+            frameNames[entry->get(0).toString()] = entry->get(1).asString();
+        }
+    }
+
+    // Try to find the "devices", "deviceTypes" and "deviceRoles" entries,
+    // each containing a list of serial numbers, types (hmd, controllers,
+    // trackers) or roles. If set, only the devices matching all the lists
+    // are published, so that several instances can publish disjoint
+    // subsets of the devices.
+    const auto readList = [&](const std::string& key) {
+        std::vector<std::string> values;
+        if (!rf.check(key)) {
+            return values;
+        }
+
+        const yarp::os::Value& value = rf.find(key);
+        if (const yarp::os::Bottle* list = value.asList()) {
+            for (size_t i = 0; i < list->size(); ++i) {
+                values.push_back(list->get(i).toString());
+            }
+        }
+        else {
+            values.push_back(value.toString());
+        }
+        return values;
+    };
+
+    openvr::DeviceSelection selection;
+    selection.serialNumbers = readList("devices");
+    selection.roles = readList("deviceRoles");
+
+    for (const auto& type : readList("deviceTypes")) {
+        const auto deviceType =
+            openvr_trackers_module::TrackedDeviceTypeFromString(type);
+
+        if (!deviceType) {
+            yError() << openvr_trackers_module::LogPrefix
+                     << "Invalid device type:" << type
+                     << "(supported: hmd, controllers, trackers)";
+            return false;
+        }
+        selection.types.push_back(*deviceType);
+    }
+
+    if (!m_manager->setDeviceSelection(selection)) {
+        yError() << openvr_trackers_module::LogPrefix
+                 << "Failed to set the device selection.";
+        return false;
+    }
+
+    // Try to find the "FILTER" group, containing lines in the form
+    // "<hmd|controllers|trackers> <none|exponential|oneEuro|kalman>
+    // [parameters]" selecting the filter of each device type, and an
+    // optional "outputs" line listing the filtered outputs among
+    // "transforms", "poses" and "state" (all of them by default)
+    m_filterTransforms = m_filterPoses = m_filterState = false;
+    if (const yarp::os::Bottle& group =
+            rf.findGroup(openvr_trackers_module::FilterGroup);
+        !group.isNull()) {
+        std::vector<std::string> outputs = {"transforms", "poses", "state"};
+
+        // The first element is the name of the group
+        for (size_t i = 1; i < group.size(); ++i) {
+            const yarp::os::Bottle* entry = group.get(i).asList();
+            const std::string key = entry ? entry->get(0).toString() : "";
+
+            std::optional<openvr::FilterParameters> parameters;
+            if (const auto type =
+                    openvr_trackers_module::TrackedDeviceTypeFromString(key);
+                type && entry->size() >= 2) {
+                parameters =
+                    openvr_trackers_module::FilterParametersFromBottle(*entry);
+                if (parameters) {
+                    m_filter.setParameters(*type, *parameters);
+                }
+            }
+            else if (key == "outputs") {
+                outputs.clear();
+                for (size_t j = 1; j < entry->size(); ++j) {
+                    outputs.push_back(entry->get(j).toString());
+                }
+                continue;
+            }
+
+            if (!parameters) {
+                yError() << openvr_trackers_module::LogPrefix
+                         << "Invalid entry in the"
+                         << openvr_trackers_module::FilterGroup
+                         << "group:" << group.get(i).toString();
+                return false;
+            }
+        }
+
+        for (const auto& output : outputs) {
+            if (output == "transforms") {
+                m_filterTransforms = true;
+            }
+            else if (output == "poses") {
+                m_filterPoses = true;
+            }
+            else if (output == "state") {
+                m_filterState = true;
+            }
+            else {
+                yError() << openvr_trackers_module::LogPrefix
+                         << "Invalid filtered output:" << output
+                         << "(supported: transforms, poses, state)";
+                return false;
+            }
+        }
+
+        if (!m_filter.enabled()) {
+            m_filterTransforms = m_filterPoses = m_filterState = false;
+        }
+    }
+
+    if (!m_manager->setFrameNaming(frameNameTemplate, frameNames)) {
+        yError() << openvr_trackers_module::LogPrefix
+                 << "Failed to set the frame names.";
+        return false;
+    }
+
+    // Try to find the "FRAME_OFFSETS" group, containing lines in the form
+    // "<serial|role> x y z roll pitch yaw" setting the fixed transform from
+    // the frame of the devices to the published one. Offsets of serial
+    // numbers override the ones of roles.
+    std::unordered_map<std::string, openvr::Transform> frameOffsets;
+    if (const yarp::os::Bottle& group =
+            rf.findGroup(openvr_trackers_module::FrameOffsetsGroup);
+        !group.isNull()) {
+        // The first element is the name of the group
+        for (size_t i = 1; i < group.size(); ++i) {
+            const yarp::os::Bottle* entry = group.get(i).asList();
+            const auto offset =
+                entry ? openvr_trackers_module::TransformFromBottle(*entry)
+                      : std::nullopt;
+
+            if (!offset) {
+                yError() << openvr_trackers_module::LogPrefix
+                         << "Invalid entry in the"
+                         << openvr_trackers_module::FrameOffsetsGroup
+                         << "group:" << group.get(i).toString();
+                return false;
+            }
+
+            frameOffsets[entry->get(0).toString()] = *offset;
+        }
+    }
+
+    if (!m_manager->setFrameOffsets(frameOffsets)) {
+        yError() << openvr_trackers_module::LogPrefix
+                 << "Failed to set the frame offsets.";
+        return false;
+    }
+    m_frameOffsets = !frameOffsets.empty();
+
+    // Create configuration of the "transformClient" device. It is also
+    // opened with batched transforms, so that the module requires the
+    // transformServer in both modes.
     yarp::os::Property tfClientCfg;
     tfClientCfg.put("device", "transformClient");
     tfClientCfg.put("local", tfLocal);
@@ -137,30 +813,134 @@ bool OpenVRTrackersModule::configure(yarp::os::ResourceFinder& rf)
         return false;
     }
 
+    if (m_batchedTransforms) {
+        // The transformServer sets one transform per RPC and has no port
+        // accepting a batch, the batch is only written on the port
+        yWarning() << openvr_trackers_module::LogPrefix
+                   << "Using batched transforms, the transforms are written"
+                   << "on the"
+                   << "/" + getName()
+                          + openvr_trackers_module::TransformsPortSuffix
+                   << "port and are NOT sent to the transformServer.";
+    }
+
     // Initialize the transform buffer
     m_sendBuffer.resize(4, 4);
     m_sendBuffer.eye();
 
-    // Initialize the OpenVR driver
-    if (!m_manager.initialize(vrOrigin)) {
+    // Initialize the OpenVR driver. The OpenVR runtime is attached in
+    // background, so that the module can be started before SteamVR and
+    // survives its restarts. The seated position is reset by
+    // updateModule() whenever the runtime is attached.
+    m_attachments = 0;
+    const bool initialized = backend == "openvr"
+                                 ? m_manager->connect(vrOrigin)
+                                 : m_manager->initialize(vrOrigin);
+
+    if (!initialized) {
         yError() << openvr_trackers_module::LogPrefix
                  << "Failed to initialize the OpenVR devices manager.";
         return false;
     }
 
-    if (!m_manager.resetSeatedPosition())
+    // The replayed poses could already contain the frame offsets and the
+    // calibration, they are not applied twice
+    const uint32_t replayedStages = m_replay ? m_replay->stages() : 0;
+
+    if ((replayedStages & openvr::PosesRecorder::FrameOffsetsStage)
+        && m_frameOffsets) {
+        yWarning() << openvr_trackers_module::LogPrefix
+                   << "The recording contains the frame offsets, ignoring the"
+                   << openvr_trackers_module::FrameOffsetsGroup << "group";
+        m_manager->setFrameOffsets({});
+        m_frameOffsets = false;
+    }
+
+    if (m_acquisitionPeriod > 0
+        && !m_manager->startAcquisition(m_acquisitionPeriod)) {
+        yError() << openvr_trackers_module::LogPrefix
+                 << "Failed to start the acquisition thread.";
+        return false;
+    }
+
+    // Settings that can be changed at runtime through the RPC port, and
+    // ports of the enabled outputs
+    m_pendingSettings.period = m_period;
+    m_pendingSettings.origin = vrOrigin;
+    m_pendingSettings.predictionMode = predictionMode.value();
+    m_pendingSettings.predictionHorizon = predictionHorizon;
+    m_pendingSettings.transforms = m_publishTransforms = true;
+    m_pendingSettings.poses = m_publishPoses;
+    m_pendingSettings.state = m_publishState;
+    m_pendingSettings.stats = m_publishStats;
+    m_settingsChanged = false;
+
     {
-        yError() << openvr_trackers_module::LogPrefix << "Failed to reset seated position.";
+        const auto settingsLock = std::unique_lock(m_settingsMutex);
+        if (!this->openOutputPorts(m_pendingSettings)) {
+            return false;
+        }
+    }
+
+    // Try to find the "calibrationFile" entry. The calibration it contains
+    // is applied to the published poses, and the computed calibrations are
+    // saved to it.
+    m_calibrated = false;
+    m_calibration = {};
+    m_calibrationQuaternion = {1, 0, 0, 0};
+    m_calibrationFile.clear();
+    if (replayedStages & openvr::PosesRecorder::UniverseTransformStage) {
+        yWarning() << openvr_trackers_module::LogPrefix
+                   << "The recording contains a calibration, ignoring the"
+                   << "calibrationFile entry";
+    }
+    else if (rf.check("calibrationFile")
+             && rf.find("calibrationFile").isString()) {
+        m_calibrationFile = rf.find("calibrationFile").asString();
+
+        if (std::ifstream(m_calibrationFile).good()) {
+            if (!this->loadCalibration(m_calibrationFile)) {
+                yError() << openvr_trackers_module::LogPrefix
+                         << "Failed to load the calibration file"
+                         << m_calibrationFile;
+                return false;
+            }
+        }
+        else {
+            yInfo() << openvr_trackers_module::LogPrefix
+                    << "No calibration in" << m_calibrationFile
+                    << ", it will be written by computeCalibration";
+        }
+    }
+
+    // The reference positions of the calibration can also be streamed
+    const std::string calibrationPortName =
+        "/" + getName() + openvr_trackers_module::CalibrationPortSuffix;
+    if (!m_calibrationPort.open(calibrationPortName)) {
+        yError() << openvr_trackers_module::LogPrefix << "Could not open"
+                 << calibrationPortName << "port.";
         return false;
     }
 
+    // The reference frames of the calibration are read from the stream of
+    // the transformServer, whose transforms carry their timestamps
+    if (!m_calibrationWorldFrame.empty()) {
+        const std::string calibrationTfPortName =
+            "/" + getName() + openvr_trackers_module::CalibrationTfPortSuffix;
+        if (!m_calibrationTfPort.open(calibrationTfPortName)) {
+            yError() << openvr_trackers_module::LogPrefix << "Could not open"
+                     << calibrationTfPortName << "port.";
+            return false;
+        }
+    }
+
     // Bind the RPC service to the module's object
     this->yarp().attachAsServer(this->m_rpcPort);
     
-    if(!m_rpcPort.open("/" + openvr_trackers_module::ModuleName +  + "/rpc"))
+    if(!m_rpcPort.open("/" + getName() + openvr_trackers_module::RpcPortSuffix))
     {
         yError() << openvr_trackers_module::LogPrefix << "Could not open"
-                 << "/" + openvr_trackers_module::ModuleName +  + "/rpc" << " RPC port.";
+                 << "/" + getName() + openvr_trackers_module::RpcPortSuffix << " RPC port.";
         return false;
     }
 
@@ -169,89 +949,255 @@ bool OpenVRTrackersModule::configure(yarp::os::ResourceFinder& rf)
 
 double OpenVRTrackersModule::getPeriod()
 {
-    const auto lock = std::unique_lock(m_mutex);
-
     return m_period;
 }
 
 bool OpenVRTrackersModule::updateModule()
 {
-    const auto lock = std::unique_lock(m_mutex);
+    // The settings changed through the RPC port take effect together from
+    // this cycle
+    if (m_settingsChanged) {
+        this->applySettings();
+    }
 
-    // compute the poses
-    m_manager.computePoses();
-    // Iterate over all the managed devices of the driver
-    for (const auto& sn : m_manager.managedDevices()) {
-
-        if (const auto& poseOpt = m_manager.pose(sn); poseOpt.has_value()) {
-
-            // Extract the pose of the device
-            const openvr::Pose& pose = poseOpt.value();
-
-            // Compute the prefix of the transform based on the device type.
-            // The final name will be "{tf_name_prefix}/{serial_number}".
-            const std::string tfNamePrefix = [&]() {
-                std::string prefix;
-
-                switch (m_manager.type(sn)) {
-                    case openvr::TrackedDeviceType::HMD:
-                        prefix = "/hmd/";
-                        break;
-                    case openvr::TrackedDeviceType::Controller:
-                        prefix = "/controllers/";
-                        break;
-                    case openvr::TrackedDeviceType::GenericTracker:
-                        prefix = "/trackers/";
-                        break;
-                    default:
-                        break;
-                }
-                return prefix;
-            }();
+    const double cycleTime = yarp::os::Time::now();
+    if (m_lastCycleTime > 0) {
+        m_cyclePeriods.record(cycleTime - m_lastCycleTime);
+    }
+    m_lastCycleTime = cycleTime;
+
+    if (m_publishStats
+        && cycleTime - m_lastStatsTime
+               >= openvr_trackers_module::StatsPublishPeriod) {
+        m_lastStatsTime = cycleTime;
+        this->publishStatistics();
+    }
 
-            // Reset the transform
-            m_sendBuffer.eye();
+    // Nothing is published while the runtime is not attached. When it is
+    // attached, possibly again after a restart, the seated position and the
+    // filters start over.
+    if (!m_manager->initialized()) {
+        return true;
+    }
 
-            // Fill the rotation of the transform using the row-major
-            // serialization used by the driver
-            m_sendBuffer[0][0] = pose.rotationRowMajor[0];
-            m_sendBuffer[0][1] = pose.rotationRowMajor[1];
-            m_sendBuffer[0][2] = pose.rotationRowMajor[2];
-            m_sendBuffer[1][0] = pose.rotationRowMajor[3];
-            m_sendBuffer[1][1] = pose.rotationRowMajor[4];
-            m_sendBuffer[1][2] = pose.rotationRowMajor[5];
-            m_sendBuffer[2][0] = pose.rotationRowMajor[6];
-            m_sendBuffer[2][1] = pose.rotationRowMajor[7];
-            m_sendBuffer[2][2] = pose.rotationRowMajor[8];
+    if (const size_t attachments = m_manager->attachments();
+        attachments != m_attachments) {
+        m_attachments = attachments;
+        m_filter.reset();
 
-            // Fill the position of the transform
-            m_sendBuffer[0][3] = pose.position[0];
-            m_sendBuffer[1][3] = pose.position[1];
-            m_sendBuffer[2][3] = pose.position[2];
+        if (!m_manager->resetSeatedPosition()) {
+            yError() << openvr_trackers_module::LogPrefix
+                     << "Failed to reset seated position.";
+        }
+    }
 
-            // Publish the transform
-            m_tf->setTransform(tfNamePrefix + sn, m_baseFrame, m_sendBuffer);
+    // Read the state of all the managed devices in a single pass. When the
+    // acquisition thread is running, take the most recent poses without
+    // blocking it, otherwise compute them now.
+    double snapshotTime;
+    if (m_acquisitionPeriod > 0) {
+        snapshotTime = yarp::os::Time::now();
 
+        if (!m_manager->latestSnapshot(m_snapshot)) {
+            return true;
         }
     }
+    else {
+        m_manager->computePoses();
+        snapshotTime = yarp::os::Time::now();
 
-    return true;
-}
+        if (!m_manager->snapshot(m_snapshot)) {
+            return true;
+        }
+    }
 
-bool OpenVRTrackersModule::close()
-{
-    const auto lock = std::unique_lock(m_mutex);
+    const double publishTime = yarp::os::Time::now();
+    m_snapshotDurations.record(publishTime - snapshotTime);
 
-    m_driver.close();
-    m_rpcPort.close();
-    return true;
-}
+    // The streamed messages carry the time the poses refer to
+    m_stamp.update(m_snapshot.timestamp);
 
-bool OpenVRTrackersModule::resetSeatedPosition()
-{
-    const auto lock = std::unique_lock(m_mutex);
+    if (m_calibrating) {
+        this->collectCalibrationSample(m_snapshot);
+    }
 
-    if (!m_manager.resetSeatedPosition())
+    // Each output publishes either the raw or the filtered poses
+    if (m_filterTransforms || m_filterPoses || m_filterState) {
+        m_filter.apply(m_snapshot, m_filtered);
+    }
+
+    const openvr::DevicesSnapshot& transformsSnapshot =
+        m_filterTransforms ? m_filtered : m_snapshot;
+    const openvr::DevicesSnapshot& posesSnapshot =
+        m_filterPoses ? m_filtered : m_snapshot;
+    const openvr::DevicesSnapshot& stateSnapshot =
+        m_filterState ? m_filtered : m_snapshot;
+
+    // The messages of all the outputs are filled before being written.
+    // With batched transforms, all the transforms of this cycle are
+    // collected in a single message, and the binary packet of the poses is
+    // filled in place and sent without copies.
+    openvr::Publication::Messages messages;
+    if (m_publishTransforms && m_batchedTransforms) {
+        messages.transforms = &m_transformsPort.prepare();
+    }
+    if (m_publishPoses) {
+        messages.poses = &m_posesPort.prepare();
+    }
+    if (m_publishState) {
+        messages.state = &m_statePort.prepare();
+    }
+
+    m_publication.fill(cycleTime,
+                       {transformsSnapshot, posesSnapshot, stateSnapshot},
+                       messages);
+
+    // The poses are recorded before the filters, the published packet is
+    // reused when it contains them
+    if (m_recorder.recording()) {
+        const openvr::PosesPacket* records = messages.poses;
+        if (!records || m_filterPoses) {
+            openvr::FillPosesPacket(
+                m_snapshot, m_publication.layout(), false, m_records);
+            records = &m_records;
+        }
+
+        m_recorder.record(*records,
+                          m_publication.layout(),
+                          m_snapshot.timestamp,
+                          m_snapshot.acquisitionTimestamp);
+    }
+
+    // Without batched transforms, the transforms are sent one by one
+    if (m_publishTransforms && !m_batchedTransforms) {
+        for (size_t i = 0; i < transformsSnapshot.size; ++i) {
+            const openvr::DeviceState& state = transformsSnapshot.devices[i];
+
+            if (state.valid) {
+                // IFrameTransform does not accept a timestamp, the
+                // transformServer stamps the transform when received
+                this->fillTransform(state.pose);
+                m_tf->setTransform(state.frameName, m_baseFrame, m_sendBuffer);
+            }
+        }
+    }
+
+    if (messages.transforms) {
+        m_transformsPort.setEnvelope(m_stamp);
+        m_transformsPort.write();
+    }
+
+    if (messages.poses) {
+        m_posesPort.setEnvelope(m_stamp);
+        m_posesPort.write();
+    }
+
+    if (messages.state) {
+        m_statePort.setEnvelope(m_stamp);
+        m_statePort.write();
+    }
+
+    const double now = yarp::os::Time::now();
+    m_publishDurations.record(now - publishTime);
+    if (m_snapshot.size > 0) {
+        m_posesAges.record(now - m_snapshot.acquisitionTimestamp);
+    }
+
+    return true;
+}
+
+void OpenVRTrackersModule::publishStatistics()
+{
+    // The bottle contains one list per measure with the following format:
+    // (name count p50 p99 max)
+    yarp::os::Bottle& stats = m_statsPort.prepare();
+    stats.clear();
+
+    for (const auto& measure : openvr_trackers_module::LatencyMeasures) {
+        const auto statistics = this->latencyStatistics(measure);
+
+        yarp::os::Bottle& entry = stats.addList();
+        entry.addString(measure);
+        entry.addInt64(int64_t(statistics->count));
+        entry.addFloat64(statistics->p50);
+        entry.addFloat64(statistics->p99);
+        entry.addFloat64(statistics->max);
+    }
+
+    m_statsPort.write();
+}
+
+std::optional<openvr::LatencyHistogram::Statistics>
+OpenVRTrackersModule::latencyStatistics(const std::string& measure) const
+{
+    if (measure == "computePoses") {
+        return m_manager->computePosesStatistics();
+    }
+    if (measure == "snapshot") {
+        return m_snapshotDurations.statistics();
+    }
+    if (measure == "publish") {
+        return m_publishDurations.statistics();
+    }
+    if (measure == "age") {
+        return m_posesAges.statistics();
+    }
+    if (measure == "period") {
+        return m_cyclePeriods.statistics();
+    }
+    return std::nullopt;
+}
+
+void OpenVRTrackersModule::fillTransform(const openvr::Pose& pose)
+{
+    // Reset the transform
+    m_sendBuffer.eye();
+
+    // Fill the rotation of the transform using the row-major
+    // serialization used by the driver
+    m_sendBuffer[0][0] = pose.rotationRowMajor[0];
+    m_sendBuffer[0][1] = pose.rotationRowMajor[1];
+    m_sendBuffer[0][2] = pose.rotationRowMajor[2];
+    m_sendBuffer[1][0] = pose.rotationRowMajor[3];
+    m_sendBuffer[1][1] = pose.rotationRowMajor[4];
+    m_sendBuffer[1][2] = pose.rotationRowMajor[5];
+    m_sendBuffer[2][0] = pose.rotationRowMajor[6];
+    m_sendBuffer[2][1] = pose.rotationRowMajor[7];
+    m_sendBuffer[2][2] = pose.rotationRowMajor[8];
+
+    // Fill the position of the transform
+    m_sendBuffer[0][3] = pose.position[0];
+    m_sendBuffer[1][3] = pose.position[1];
+    m_sendBuffer[2][3] = pose.position[2];
+}
+
+bool OpenVRTrackersModule::close()
+{
+    const auto lock = std::unique_lock(m_mutex);
+
+    if (m_manager) {
+        m_manager->stopAcquisition();
+    }
+
+    if (m_recorder.recording()) {
+        m_recorder.stop();
+    }
+
+    m_driver.close();
+    m_rpcPort.close();
+    m_statePort.close();
+    m_transformsPort.close();
+    m_posesPort.close();
+    m_statsPort.close();
+    m_calibrationPort.close();
+    m_calibrationTfPort.close();
+    m_posesPortOpen = m_statePortOpen = m_statsPortOpen = false;
+    return true;
+}
+
+bool OpenVRTrackersModule::resetSeatedPosition()
+{
+    if (!m_manager->resetSeatedPosition())
     {
         yError() << openvr_trackers_module::LogPrefix << "Failed to reset seated position.";
         return false;
@@ -259,3 +1205,669 @@ bool OpenVRTrackersModule::resetSeatedPosition()
 
     return true;
 }
+
+bool OpenVRTrackersModule::setPrediction(const std::string& mode,
+                                         const double horizon)
+{
+    const auto predictionMode =
+        openvr_trackers_module::PredictionModeFromString(mode);
+
+    if (!predictionMode) {
+        yError() << openvr_trackers_module::LogPrefix
+                 << "Invalid prediction mode:" << mode;
+        return false;
+    }
+
+    const auto lock = std::unique_lock(m_settingsMutex);
+
+    Settings settings = m_pendingSettings;
+    settings.predictionMode = predictionMode.value();
+    settings.predictionHorizon = horizon;
+    return this->stageSettings(settings);
+}
+
+std::string OpenVRTrackersModule::getPredictionMode()
+{
+    const auto lock = std::unique_lock(m_settingsMutex);
+    return openvr_trackers_module::PredictionModeToString(
+        m_pendingSettings.predictionMode);
+}
+
+double OpenVRTrackersModule::getPredictionHorizon()
+{
+    const auto lock = std::unique_lock(m_settingsMutex);
+    return m_pendingSettings.predictionHorizon;
+}
+
+std::vector<std::string> OpenVRTrackersModule::getLatencyMeasures()
+{
+    return openvr_trackers_module::LatencyMeasures;
+}
+
+LatencyStatistics
+OpenVRTrackersModule::getLatencyStatistics(const std::string& measure)
+{
+    LatencyStatistics out;
+    const auto statistics = this->latencyStatistics(measure);
+
+    if (!statistics) {
+        yError() << openvr_trackers_module::LogPrefix
+                 << "Invalid latency measure:" << measure;
+        return out;
+    }
+
+    out.count = int64_t(statistics->count);
+    out.p50 = statistics->p50;
+    out.p99 = statistics->p99;
+    out.max = statistics->max;
+    return out;
+}
+
+bool OpenVRTrackersModule::resetLatencyStatistics()
+{
+    m_manager->resetStatistics();
+    m_snapshotDurations.reset();
+    m_publishDurations.reset();
+    m_posesAges.reset();
+    m_cyclePeriods.reset();
+    return true;
+}
+
+bool OpenVRTrackersModule::startRecording(const std::string& path)
+{
+    // Stages applied to the poses by the manager, including the ones of a
+    // replayed recording
+    uint32_t stages = m_replay ? m_replay->stages() : 0;
+    if (m_frameOffsets) {
+        stages |= openvr::PosesRecorder::FrameOffsetsStage;
+    }
+    {
+        const auto lock = std::unique_lock(m_calibrationMutex);
+        if (m_calibrated) {
+            stages |= openvr::PosesRecorder::UniverseTransformStage;
+        }
+    }
+
+    if (!m_recorder.start(path, stages)) {
+        yError() << openvr_trackers_module::LogPrefix
+                 << "Failed to start recording.";
+        return false;
+    }
+
+    return true;
+}
+
+bool OpenVRTrackersModule::stopRecording()
+{
+    return m_recorder.stop();
+}
+
+bool OpenVRTrackersModule::isRecording()
+{
+    return m_recorder.recording();
+}
+
+bool OpenVRTrackersModule::seekReplay(const double time)
+{
+    if (!m_replay) {
+        yError() << openvr_trackers_module::LogPrefix
+                 << "The replay backend is not in use";
+        return false;
+    }
+
+    return m_replay->seek(time);
+}
+
+bool OpenVRTrackersModule::startCalibration(const std::string& serialNumber,
+                                            const std::string& referenceFrame)
+{
+    const auto lock = std::unique_lock(m_calibrationMutex);
+
+    if (!referenceFrame.empty()) {
+        if (m_calibrationWorldFrame.empty()) {
+            yError() << openvr_trackers_module::LogPrefix
+                     << "The calibrationWorldFrame option is required to"
+                     << "calibrate with the frame" << referenceFrame;
+            return false;
+        }
+
+        // Connect to the stream of the transformServer, which could have
+        // been started after the module
+        if (m_calibrationTfPort.getInputCount() == 0
+            && !yarp::os::Network::connect(m_tfStream,
+                                           m_calibrationTfPort.getName())) {
+            yError() << openvr_trackers_module::LogPrefix
+                     << "Failed to connect to" << m_tfStream;
+            return false;
+        }
+    }
+
+    m_calibrationSerial = serialNumber;
+    m_calibrationFrame = referenceFrame;
+    m_calibrationFrameWarned = false;
+    m_registration.reset();
+    m_calibrating = true;
+
+    const std::string reference =
+        referenceFrame.empty()
+            ? "/" + getName() + openvr_trackers_module::CalibrationPortSuffix
+            : referenceFrame;
+    yInfo() << openvr_trackers_module::LogPrefix << "Calibrating"
+            << serialNumber << "with the positions of" << reference;
+    return true;
+}
+
+std::int64_t OpenVRTrackersModule::getCalibrationSamples()
+{
+    const auto lock = std::unique_lock(m_calibrationMutex);
+    return std::int64_t(m_registration.size());
+}
+
+CalibrationResult OpenVRTrackersModule::computeCalibration()
+{
+    const auto lock = std::unique_lock(m_calibrationMutex);
+    m_calibrating = false;
+
+    std::array<double, 4> quaternion;
+    const auto transform = m_registration.solve(quaternion);
+    if (!transform) {
+        yError() << openvr_trackers_module::LogPrefix
+                 << "Failed to compute the calibration from"
+                 << m_registration.size()
+                 << "samples, at least 3 non collinear positions are needed";
+        CalibrationResult result;
+        result.valid = false;
+        result.samples = std::int64_t(m_registration.size());
+        return result;
+    }
+
+    m_calibrated = true;
+    m_calibration = *transform;
+    m_calibrationQuaternion = quaternion;
+    m_calibrationSamples = m_registration.size();
+    m_calibrationRms = m_registration.rms(*transform);
+    m_manager->setUniverseTransform(m_calibration);
+
+    yInfo() << openvr_trackers_module::LogPrefix << "Calibration computed from"
+            << m_calibrationSamples << "samples, rms" << m_calibrationRms
+            << "m";
+
+    if (!m_calibrationFile.empty()
+        && !this->saveCalibration(m_calibrationFile)) {
+        yError() << openvr_trackers_module::LogPrefix
+                 << "Failed to save the calibration to" << m_calibrationFile;
+    }
+
+    return this->calibrationResult();
+}
+
+CalibrationResult OpenVRTrackersModule::getCalibration()
+{
+    const auto lock = std::unique_lock(m_calibrationMutex);
+    return this->calibrationResult();
+}
+
+bool OpenVRTrackersModule::resetCalibration()
+{
+    const auto lock = std::unique_lock(m_calibrationMutex);
+    m_calibrating = false;
+    m_registration.reset();
+    m_calibrated = false;
+    m_calibration = {};
+    m_calibrationQuaternion = {1, 0, 0, 0};
+    return m_manager->setUniverseTransform(m_calibration);
+}
+
+std::vector<DeviceInfo> OpenVRTrackersModule::getDevices()
+{
+    std::vector<DeviceInfo> devices;
+
+    // Read the latest poses without blocking their computation
+    const auto snapshot = std::make_unique<openvr::DevicesSnapshot>();
+    if (!m_manager->latestSnapshot(*snapshot)) {
+        return devices;
+    }
+
+    // The timestamps of the poses include the prediction
+    const double prediction =
+        snapshot->timestamp - snapshot->acquisitionTimestamp;
+    const double now = yarp::os::Time::now();
+
+    for (size_t i = 0; i < snapshot->size; ++i) {
+        const openvr::DeviceState& state = snapshot->devices[i];
+
+        DeviceInfo info;
+        info.serialNumber = state.serialNumber;
+        info.frameName = state.frameName;
+        info.type = openvr::TrackedDeviceTypeName(state.type);
+
+        // The device could have been removed after the snapshot
+        const auto properties = m_manager->properties(state.serialNumber);
+        info.role = properties ? properties->role : "";
+        info.index = std::int64_t(state.index);
+        info.valid = state.valid;
+        info.trackingResult = openvr_trackers_module::TrackingResultToString(
+            state.pose.trackingResult);
+        info.age = state.timestamp > 0 ? now - (state.timestamp - prediction)
+                                       : -1;
+        devices.push_back(std::move(info));
+    }
+
+    return devices;
+}
+
+RuntimeSettings OpenVRTrackersModule::getSettings()
+{
+    const auto lock = std::unique_lock(m_settingsMutex);
+
+    RuntimeSettings settings;
+    settings.period = m_pendingSettings.period;
+    settings.origin = openvr_trackers_module::TrackingUniverseOriginToString(
+        m_pendingSettings.origin);
+    settings.predictionMode = openvr_trackers_module::PredictionModeToString(
+        m_pendingSettings.predictionMode);
+    settings.predictionHorizon = m_pendingSettings.predictionHorizon;
+
+    for (const auto& [output, enabled] :
+         {std::pair{"transforms", m_pendingSettings.transforms},
+          std::pair{"poses", m_pendingSettings.poses},
+          std::pair{"state", m_pendingSettings.state},
+          std::pair{"stats", m_pendingSettings.stats}}) {
+        if (enabled) {
+            settings.outputs.push_back(output);
+        }
+    }
+
+    return settings;
+}
+
+bool OpenVRTrackersModule::setSettings(const RuntimeSettings& settings)
+{
+    const auto origin =
+        openvr_trackers_module::TrackingUniverseOriginFromString(
+            settings.origin);
+    if (!origin) {
+        yError() << openvr_trackers_module::LogPrefix
+                 << "Invalid origin:" << settings.origin;
+        return false;
+    }
+
+    const auto predictionMode =
+        openvr_trackers_module::PredictionModeFromString(
+            settings.predictionMode);
+    if (!predictionMode) {
+        yError() << openvr_trackers_module::LogPrefix
+                 << "Invalid prediction mode:" << settings.predictionMode;
+        return false;
+    }
+
+    Settings staged;
+    staged.period = settings.period;
+    staged.origin = origin.value();
+    staged.predictionMode = predictionMode.value();
+    staged.predictionHorizon = settings.predictionHorizon;
+
+    if (!this->parseOutputs(settings.outputs, staged)) {
+        return false;
+    }
+
+    const auto lock = std::unique_lock(m_settingsMutex);
+    return this->stageSettings(staged);
+}
+
+bool OpenVRTrackersModule::setPublishPeriod(const double period)
+{
+    const auto lock = std::unique_lock(m_settingsMutex);
+
+    Settings settings = m_pendingSettings;
+    settings.period = period;
+    return this->stageSettings(settings);
+}
+
+bool OpenVRTrackersModule::setOrigin(const std::string& origin)
+{
+    const auto vrOrigin =
+        openvr_trackers_module::TrackingUniverseOriginFromString(origin);
+
+    if (!vrOrigin) {
+        yError() << openvr_trackers_module::LogPrefix
+                 << "Invalid origin:" << origin
+                 << "(supported: seated, standing, raw)";
+        return false;
+    }
+
+    const auto lock = std::unique_lock(m_settingsMutex);
+
+    Settings settings = m_pendingSettings;
+    settings.origin = vrOrigin.value();
+    return this->stageSettings(settings);
+}
+
+bool OpenVRTrackersModule::setOutputs(const std::vector<std::string>& outputs)
+{
+    const auto lock = std::unique_lock(m_settingsMutex);
+
+    Settings settings = m_pendingSettings;
+    if (!this->parseOutputs(outputs, settings)) {
+        return false;
+    }
+
+    return this->stageSettings(settings);
+}
+
+bool OpenVRTrackersModule::parseOutputs(
+    const std::vector<std::string>& outputs,
+    Settings& settings) const
+{
+    settings.transforms = settings.poses = false;
+    settings.state = settings.stats = false;
+
+    for (const auto& output : outputs) {
+        if (output == "transforms") {
+            settings.transforms = true;
+        }
+        else if (output == "poses") {
+            settings.poses = true;
+        }
+        else if (output == "state") {
+            settings.state = true;
+        }
+        else if (output == "stats") {
+            settings.stats = true;
+        }
+        else {
+            yError() << openvr_trackers_module::LogPrefix
+                     << "Invalid output:" << output
+                     << "(supported: transforms, poses, state, stats)";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool OpenVRTrackersModule::openOutputPorts(const Settings& settings)
+{
+    const auto open = [this](yarp::os::Contactable& port,
+                             bool& isOpen,
+                             const std::string& suffix) {
+        if (isOpen) {
+            return true;
+        }
+
+        const std::string name = "/" + getName() + suffix;
+        if (!port.open(name)) {
+            yError() << openvr_trackers_module::LogPrefix << "Could not open"
+                     << name << "port.";
+            return false;
+        }
+
+        isOpen = true;
+        return true;
+    };
+
+    return (!settings.poses
+            || open(m_posesPort,
+                    m_posesPortOpen,
+                    openvr_trackers_module::PosesPortSuffix))
+           && (!settings.state
+               || open(m_statePort,
+                       m_statePortOpen,
+                       openvr_trackers_module::StatePortSuffix))
+           && (!settings.stats
+               || open(m_statsPort,
+                       m_statsPortOpen,
+                       openvr_trackers_module::StatsPortSuffix));
+}
+
+bool OpenVRTrackersModule::stageSettings(const Settings& settings)
+{
+    // Called by the RPC thread with m_settingsMutex locked
+    if (!(settings.period > 0)) {
+        yError() << openvr_trackers_module::LogPrefix
+                 << "Invalid period:" << settings.period;
+        return false;
+    }
+
+    if (!(settings.predictionHorizon >= 0)) {
+        yError() << openvr_trackers_module::LogPrefix
+                 << "Invalid prediction horizon:"
+                 << settings.predictionHorizon;
+        return false;
+    }
+
+    // Opening the ports can take a while, updateModule() keeps publishing
+    // with the previous settings in the meantime
+    if (!this->openOutputPorts(settings)) {
+        return false;
+    }
+
+    m_pendingSettings = settings;
+    m_settingsChanged = true;
+    return true;
+}
+
+void OpenVRTrackersModule::applySettings()
+{
+    // Never wait for the RPC thread, the settings it is staging are applied
+    // at the next cycle
+    auto lock = std::unique_lock(m_settingsMutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        return;
+    }
+
+    const Settings settings = m_pendingSettings;
+    m_settingsChanged = false;
+    lock.unlock();
+
+    m_period = settings.period;
+
+    // The filters would smooth the jump of the poses to the new origin
+    if (settings.origin != m_manager->trackingUniverseOrigin()) {
+        m_manager->setTrackingUniverseOrigin(settings.origin);
+        m_filter.reset();
+    }
+
+    if (settings.predictionMode != m_manager->predictionMode()
+        || settings.predictionHorizon != m_manager->predictionHorizon()) {
+        m_manager->setPrediction(settings.predictionMode,
+                                 settings.predictionHorizon);
+    }
+
+    m_publishTransforms = settings.transforms;
+    m_publishPoses = settings.poses;
+    m_publishState = settings.state;
+    m_publishStats = settings.stats;
+}
+
+void OpenVRTrackersModule::collectCalibrationSample(
+    const openvr::DevicesSnapshot& snapshot)
+{
+    const auto lock = std::unique_lock(m_calibrationMutex);
+
+    const openvr::DeviceState* device = nullptr;
+    for (size_t i = 0; i < snapshot.size; ++i) {
+        if (snapshot.devices[i].serialNumber == m_calibrationSerial) {
+            device = &snapshot.devices[i];
+            break;
+        }
+    }
+
+    if (!(device && device->valid)) {
+        return;
+    }
+
+    // Reference position of the tracker
+    std::array<double, 3> target;
+    if (!m_calibrationFrame.empty()) {
+        const yarp::os::Bottle* transforms = m_calibrationTfPort.read(false);
+        if (!transforms) {
+            return;
+        }
+
+        // The stream contains one list per transform with the following
+        // format: (parent child timestamp tx ty tz qw qx qy qz)
+        const yarp::os::Bottle* transform = nullptr;
+        for (size_t i = 0; i < transforms->size() && !transform; ++i) {
+            const yarp::os::Bottle* entry = transforms->get(i).asList();
+            if (entry && entry->size() >= 6
+                && entry->get(0).asString() == m_calibrationWorldFrame
+                && entry->get(1).asString() == m_calibrationFrame) {
+                transform = entry;
+            }
+        }
+
+        if (!transform) {
+            if (!m_calibrationFrameWarned) {
+                yWarning() << openvr_trackers_module::LogPrefix
+                           << "The transform from" << m_calibrationWorldFrame
+                           << "to" << m_calibrationFrame
+                           << "is not streamed by" << m_tfStream;
+                m_calibrationFrameWarned = true;
+            }
+            return;
+        }
+
+        // The transform must refer to the time of the pose
+        if (std::abs(transform->get(2).asFloat64() - device->timestamp)
+            > openvr_trackers_module::CalibrationMaxTimeOffset) {
+            return;
+        }
+
+        for (size_t i = 0; i < 3; ++i) {
+            target[i] = transform->get(3 + i).asFloat64();
+        }
+    }
+    else {
+        const yarp::os::Bottle* reference = m_calibrationPort.read(false);
+        if (!(reference && reference->size() >= 3)) {
+            return;
+        }
+
+        // Stamped positions must refer to the time of the pose
+        yarp::os::Stamp stamp;
+        if (m_calibrationPort.getEnvelope(stamp) && stamp.isValid()
+            && std::abs(stamp.getTime() - device->timestamp)
+                   > openvr_trackers_module::CalibrationMaxTimeOffset) {
+            return;
+        }
+
+        for (size_t i = 0; i < 3; ++i) {
+            target[i] = reference->get(i).asFloat64();
+        }
+    }
+
+    // Position of the tracker in the tracking universe, removing the
+    // calibration currently applied
+    const auto& R = m_calibration.rotationRowMajor;
+    const auto& p = device->pose.position;
+    const auto& t = m_calibration.position;
+
+    std::array<double, 3> source;
+    for (size_t i = 0; i < 3; ++i) {
+        source[i] = R[i] * (p[0] - t[0]) + R[3 + i] * (p[1] - t[1])
+                    + R[6 + i] * (p[2] - t[2]);
+    }
+
+    if (m_registration.size() > 0) {
+        const double distance =
+            std::sqrt(std::pow(source[0] - m_lastCalibrationSource[0], 2)
+                      + std::pow(source[1] - m_lastCalibrationSource[1], 2)
+                      + std::pow(source[2] - m_lastCalibrationSource[2], 2));
+
+        if (distance < openvr_trackers_module::CalibrationMinDistance) {
+            return;
+        }
+    }
+
+    m_registration.addPair(source, target);
+    m_lastCalibrationSource = source;
+}
+
+bool OpenVRTrackersModule::loadCalibration(const std::string& path)
+{
+    yarp::os::Property file;
+    if (!file.fromConfigFile(path)) {
+        return false;
+    }
+
+    const yarp::os::Bottle* position = file.find("position").asList();
+    const yarp::os::Bottle* quaternion = file.find("quaternion").asList();
+
+    if (!(position && position->size() == 3 && quaternion
+          && quaternion->size() == 4)) {
+        return false;
+    }
+
+    std::array<double, 4> q;
+    for (size_t i = 0; i < 4; ++i) {
+        q[i] = quaternion->get(i).asFloat64();
+    }
+
+    const double norm =
+        std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    if (!(norm > 0)) {
+        return false;
+    }
+
+    // The quaternion is reported as saved, normalized
+    for (size_t i = 0; i < 3; ++i) {
+        m_calibration.position[i] = position->get(i).asFloat64();
+    }
+    for (size_t i = 0; i < 4; ++i) {
+        m_calibrationQuaternion[i] = q[i] / norm;
+    }
+    openvr::QuaternionToRotation(m_calibrationQuaternion.data(),
+                                 m_calibration.rotationRowMajor.data());
+
+    m_calibrated = true;
+    m_calibrationSamples = size_t(file.find("samples").asInt64());
+    m_calibrationRms = file.find("rms").asFloat64();
+    m_manager->setUniverseTransform(m_calibration);
+
+    yInfo() << openvr_trackers_module::LogPrefix << "Loaded the calibration"
+            << path;
+    return true;
+}
+
+bool OpenVRTrackersModule::saveCalibration(const std::string& path) const
+{
+    const CalibrationResult result = this->calibrationResult();
+
+    std::ofstream file(path);
+    file.precision(17);
+
+    file << "# Transform from the OpenVR tracking universe to the "
+            "reference frame\n";
+    file << "position (" << result.transform[0] << " " << result.transform[1]
+         << " " << result.transform[2] << ")\n";
+    file << "quaternion (" << result.transform[3] << " "
+         << result.transform[4] << " " << result.transform[5] << " "
+         << result.transform[6] << ")\n";
+    file << "samples " << result.samples << "\n";
+    file << "rms " << result.rms << "\n";
+
+    file.close();
+    return !file.fail();
+}
+
+CalibrationResult OpenVRTrackersModule::calibrationResult() const
+{
+    CalibrationResult result;
+    result.valid = m_calibrated;
+    result.samples = std::int64_t(m_calibrationSamples);
+    result.rms = m_calibrationRms;
+
+    // The quaternion is not converted back from the rotation matrix, which
+    // is inaccurate close to half turns
+    const auto& q = m_calibrationQuaternion;
+
+    result.transform = {m_calibration.position[0],
+                        m_calibration.position[1],
+                        m_calibration.position[2],
+                        q[0],
+                        q[1],
+                        q[2],
+                        q[3]};
+    return result;
+}
@@ -12,6 +12,12 @@
 #define OPENVR_TRACKERS_MODULE_H
 
 #include "OpenVRTrackersDriver.h"
+#include "PosesFilter.h"
+#include "PosesPacket.h"
+#include "PosesRecorder.h"
+#include "Publication.h"
+#include "ReplayBackend.h"
+#include "RigidRegistration.h"
 #include <thrifts/OpenVRTrackersCommands.h>
 
 #include <yarp/dev/IFrameTransform.h>
@@ -19,8 +25,16 @@
 #include <yarp/os/RFModule.h>
 #include <yarp/sig/Matrix.h>
 #include <yarp/os/Port.h>
+#include <yarp/os/BufferedPort.h>
+#include <yarp/os/Bottle.h>
+#include <yarp/os/Stamp.h>
 
+#include <array>
+#include <atomic>
+#include <memory>
+#include <optional>
 #include <string>
+#include <unordered_map>
 #include <mutex>
 #include <cctype>
 #include <algorithm>
@@ -34,20 +48,166 @@ public:
     bool updateModule() override;
     bool close() override;
     bool resetSeatedPosition() override;
+    bool setPrediction(const std::string& mode, const double horizon) override;
+    std::string getPredictionMode() override;
+    double getPredictionHorizon() override;
+    std::vector<std::string> getLatencyMeasures() override;
+    LatencyStatistics getLatencyStatistics(const std::string& measure) override;
+    bool resetLatencyStatistics() override;
+    bool startRecording(const std::string& path) override;
+    bool stopRecording() override;
+    bool isRecording() override;
+    bool seekReplay(const double time) override;
+    bool startCalibration(const std::string& serialNumber,
+                          const std::string& referenceFrame) override;
+    std::int64_t getCalibrationSamples() override;
+    CalibrationResult computeCalibration() override;
+    CalibrationResult getCalibration() override;
+    bool resetCalibration() override;
+    std::vector<DeviceInfo> getDevices() override;
+    RuntimeSettings getSettings() override;
+    bool setSettings(const RuntimeSettings& settings) override;
+    bool setPublishPeriod(const double period) override;
+    bool setOrigin(const std::string& origin) override;
+    bool setOutputs(const std::vector<std::string>& outputs) override;
 
 private:
+    // Settings that can be changed at runtime
+    struct Settings
+    {
+        double period = 0;
+        openvr::TrackingUniverseOrigin origin =
+            openvr::TrackingUniverseOrigin::Seated;
+        openvr::PredictionMode predictionMode =
+            openvr::PredictionMode::Runtime;
+        double predictionHorizon = 0;
+        bool transforms = true;
+        bool poses = false;
+        bool state = false;
+        bool stats = false;
+    };
+
+    // Fill the 4x4 matrix sent to the transformServer
+    void fillTransform(const openvr::Pose& pose);
+    void publishStatistics();
+    std::optional<openvr::LatencyHistogram::Statistics>
+    latencyStatistics(const std::string& measure) const;
+    void collectCalibrationSample(const openvr::DevicesSnapshot& snapshot);
+    bool loadCalibration(const std::string& path);
+    bool saveCalibration(const std::string& path) const;
+    CalibrationResult calibrationResult() const;
+    bool parseOutputs(const std::vector<std::string>& outputs,
+                      Settings& settings) const;
+    bool openOutputPorts(const Settings& settings);
+    bool stageSettings(const Settings& settings);
+    void applySettings();
+
     double m_period;
+    double m_acquisitionPeriod = 0;
     std::string m_baseFrame;
 
     yarp::sig::Matrix m_sendBuffer;
-    yarp::dev::IFrameTransform* m_tf;
+    openvr::DevicesSnapshot m_snapshot;
+
+    // Filtered copy of m_snapshot, published by the selected outputs
+    openvr::PosesFilter m_filter;
+    openvr::DevicesSnapshot m_filtered;
+    bool m_filterTransforms = false;
+    bool m_filterPoses = false;
+    bool m_filterState = false;
+
+    yarp::os::Stamp m_stamp;
+    yarp::dev::IFrameTransform* m_tf = nullptr;
+
+    bool m_batchedTransforms = false;
+    yarp::os::BufferedPort<yarp::os::Bottle> m_transformsPort;
 
     yarp::dev::PolyDriver m_driver;
 
-    openvr::DevicesManager m_manager;
+    std::unique_ptr<openvr::DevicesManager> m_manager;
+
+    // Attachments of the runtime already handled by updateModule()
+    size_t m_attachments = 0;
+
+    // Owned by the manager, set when replaying a recording
+    openvr::ReplayBackend* m_replay = nullptr;
 
     yarp::os::Port m_rpcPort;
 
+    bool m_publishTransforms = true;
+    bool m_publishPoses = false;
+    yarp::os::BufferedPort<openvr::PosesPacket> m_posesPort;
+
+    // Messages of the outputs, and names of the devices of the poses
+    // stream and of the recordings
+    openvr::Publication m_publication;
+
+    // Records of the unfiltered poses written by the recorder, when they
+    // are not published on the poses port
+    openvr::PosesPacket m_records;
+    openvr::PosesRecorder m_recorder;
+
+    // Whether the manager applies frame offsets, stored in the recordings
+    bool m_frameOffsets = false;
+
+    bool m_publishState = false;
+    yarp::os::BufferedPort<yarp::os::Bottle> m_statePort;
+
+    // Latency instrumentation. The duration of the computation of the
+    // poses is measured by the manager.
+    openvr::LatencyHistogram m_snapshotDurations;
+    openvr::LatencyHistogram m_publishDurations;
+    openvr::LatencyHistogram m_posesAges;
+    openvr::LatencyHistogram m_cyclePeriods;
+    double m_lastCycleTime = 0;
+
+    bool m_publishStats = false;
+    double m_lastStatsTime = 0;
+    yarp::os::BufferedPort<yarp::os::Bottle> m_statsPort;
+
+    // Calibration of the transform from the tracking universe to a
+    // reference frame. The state is protected by m_calibrationMutex, the
+    // flag is also read without it by updateModule().
+    std::atomic<bool> m_calibrating = false;
+    std::string m_calibrationSerial;
+    std::string m_calibrationFrame;
+    openvr::RigidRegistration m_registration;
+    std::array<double, 3> m_lastCalibrationSource = {};
+    yarp::os::BufferedPort<yarp::os::Bottle> m_calibrationPort;
+
+    // The reference frames are read with respect to the world frame of the
+    // robot from the stream of the transformServer, which carries the
+    // timestamps of the transforms
+    std::string m_calibrationWorldFrame;
+    std::string m_tfStream;
+    yarp::os::BufferedPort<yarp::os::Bottle> m_calibrationTfPort;
+    bool m_calibrationFrameWarned = false;
+
+    // Calibration applied to the published poses
+    bool m_calibrated = false;
+    openvr::Transform m_calibration;
+    // Quaternion of the rotation of m_calibration, as computed or loaded
+    std::array<double, 4> m_calibrationQuaternion = {1, 0, 0, 0};
+    size_t m_calibrationSamples = 0;
+    double m_calibrationRms = 0;
+    std::string m_calibrationFile;
+    mutable std::mutex m_calibrationMutex;
+
+    // Settings set through the RPC port and not applied yet. They are
+    // applied together by updateModule() at the beginning of the next
+    // cycle, unless the RPC thread is staging others at the same time.
+    Settings m_pendingSettings;
+    std::atomic<bool> m_settingsChanged = false;
+    std::mutex m_settingsMutex;
+
+    // Output ports opened so far, protected by m_settingsMutex. They stay
+    // open when their output is disabled.
+    bool m_posesPortOpen = false;
+    bool m_statePortOpen = false;
+    bool m_statsPortOpen = false;
+
+    // Serializes configure() and close(). The other methods only rely on
+    // the thread safety of the manager.
     mutable std::mutex m_mutex;
 };
 
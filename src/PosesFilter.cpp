@@ -0,0 +1,384 @@
+/*
+ * Copyright (C) 2021 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include "PosesFilter.h"
+#include "Rotations.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    constexpr double TwoPi = 6.283185307179586;
+
+    // Snapshots farther apart restart the filters from the measured poses
+    constexpr double MaxTimeStep = 0.5;
+
+    // Initial variance of the velocity estimated by the Kalman filter
+    constexpr double InitialVelocityVariance = 1.0;
+
+    // Smoothing factor of a first-order low-pass filter with the given
+    // cutoff frequency
+    inline double Alpha(const double cutoff, const double dt)
+    {
+        const double r = TwoPi * cutoff * dt;
+        return r / (1 + r);
+    }
+} // namespace
+
+void openvr::PosesFilter::Bank::resize(const size_t size)
+{
+    for (auto* signals : {&measurement,
+                          &value,
+                          &parameter0,
+                          &parameter1,
+                          &parameter2,
+                          &state0,
+                          &state1,
+                          &state2,
+                          &state3}) {
+        signals->resize(size);
+    }
+}
+
+void openvr::PosesFilter::setParameters(const TrackedDeviceType type,
+                                        const FilterParameters& parameters)
+{
+    if (const size_t index = TypeIndex(type); index < m_parameters.size()) {
+        m_parameters[index] = parameters;
+        m_layoutDirty = true;
+    }
+}
+
+openvr::FilterParameters
+openvr::PosesFilter::parameters(const TrackedDeviceType type) const
+{
+    const size_t index = TypeIndex(type);
+    return index < m_parameters.size() ? m_parameters[index]
+                                       : FilterParameters();
+}
+
+bool openvr::PosesFilter::enabled() const
+{
+    return std::any_of(m_parameters.begin(),
+                       m_parameters.end(),
+                       [](const FilterParameters& parameters) {
+                           return parameters.type != FilterType::None;
+                       });
+}
+
+void openvr::PosesFilter::reset()
+{
+    for (Slot& slot : m_slots) {
+        slot.reset = true;
+    }
+    m_lastTimestamp = 0;
+}
+
+void openvr::PosesFilter::apply(const DevicesSnapshot& raw,
+                                DevicesSnapshot& filtered)
+{
+    filtered.timestamp = raw.timestamp;
+    filtered.acquisitionTimestamp = raw.acquisitionTimestamp;
+    filtered.size = raw.size;
+    std::copy_n(raw.devices.begin(), raw.size, filtered.devices.begin());
+
+    if (!this->enabled()) {
+        return;
+    }
+
+    if (m_layoutDirty || this->layoutChanged(raw)) {
+        this->rebuild(raw);
+    }
+
+    const double dt = raw.timestamp - m_lastTimestamp;
+
+    // On the first snapshot, after a reset or a gap, the signals restart
+    // from the measurements and there is no time step to filter with
+    const bool restart = m_lastTimestamp == 0 || dt > MaxTimeStep || dt < 0;
+    if (restart) {
+        this->reset();
+    }
+
+    // Filter only new poses
+    if (restart || dt > 0) {
+        m_lastTimestamp = raw.timestamp;
+
+        // Gather the measurements
+        for (size_t i = 0; i < raw.size; ++i) {
+            Slot& slot = m_slots[i];
+            const DeviceState& state = raw.devices[i];
+
+            if (slot.type == FilterType::None) {
+                continue;
+            }
+
+            if (!state.valid) {
+                slot.reset = true;
+                continue;
+            }
+
+            Bank& bank = m_banks[size_t(slot.type)];
+            double* z = bank.measurement.data() + slot.offset;
+
+            std::copy_n(state.pose.position.begin(), 3, z);
+            std::copy_n(state.pose.quaternion.begin(), 4, z + 3);
+
+            if (slot.reset) {
+                this->resetSignals(slot);
+                slot.reset = false;
+                continue;
+            }
+
+            // Keep the quaternion in the hemisphere of the filtered one
+            const double* q = bank.value.data() + slot.offset + 3;
+            if (z[3] * q[0] + z[4] * q[1] + z[5] * q[2] + z[6] * q[3] < 0) {
+                for (size_t j = 3; j < Components; ++j) {
+                    z[j] = -z[j];
+                }
+            }
+        }
+
+        if (!restart) {
+            this->runFilters(dt);
+        }
+    }
+
+    // Scatter the filtered poses
+    for (size_t i = 0; i < raw.size; ++i) {
+        const Slot& slot = m_slots[i];
+        DeviceState& state = filtered.devices[i];
+
+        if (slot.type == FilterType::None || slot.reset || !state.valid) {
+            continue;
+        }
+
+        const double* value =
+            m_banks[size_t(slot.type)].value.data() + slot.offset;
+
+        const double* q = value + 3;
+        const double norm =
+            std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+
+        std::copy_n(value, 3, state.pose.position.begin());
+        for (size_t j = 0; j < 4; ++j) {
+            state.pose.quaternion[j] = q[j] / norm;
+        }
+        QuaternionToRotation(state.pose.quaternion.data(),
+                             state.pose.rotationRowMajor.data());
+    }
+}
+
+// ===============
+// Private methods
+// ===============
+
+size_t openvr::PosesFilter::TypeIndex(const TrackedDeviceType type)
+{
+    switch (type) {
+        case TrackedDeviceType::HMD:
+            return 0;
+        case TrackedDeviceType::Controller:
+            return 1;
+        case TrackedDeviceType::GenericTracker:
+            return 2;
+        default:
+            return 3;
+    }
+}
+
+bool openvr::PosesFilter::layoutChanged(const DevicesSnapshot& raw) const
+{
+    if (m_slots.size() != raw.size) {
+        return true;
+    }
+
+    for (size_t i = 0; i < raw.size; ++i) {
+        if (m_slots[i].serialNumber != raw.devices[i].serialNumber) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void openvr::PosesFilter::rebuild(const DevicesSnapshot& raw)
+{
+    const std::vector<Slot> oldSlots = std::move(m_slots);
+    m_slots.clear();
+    const std::array<Bank, 4> oldBanks = m_banks;
+
+    // Assign the devices to the banks of their filters
+    m_slots.resize(raw.size);
+    for (Bank& bank : m_banks) {
+        bank.devices = 0;
+    }
+
+    for (size_t i = 0; i < raw.size; ++i) {
+        const DeviceState& state = raw.devices[i];
+        const FilterParameters parameters = this->parameters(state.type);
+
+        Slot& slot = m_slots[i];
+        slot.serialNumber = state.serialNumber;
+        slot.type = parameters.type;
+        slot.reset = true;
+
+        if (slot.type == FilterType::None) {
+            continue;
+        }
+
+        Bank& bank = m_banks[size_t(slot.type)];
+        slot.offset = Components * bank.devices++;
+        bank.resize(Components * bank.devices);
+
+        double values[3] = {};
+        switch (slot.type) {
+            case FilterType::Exponential:
+                values[0] = parameters.timeConstant;
+                break;
+            case FilterType::OneEuro:
+                values[0] = parameters.minCutoff;
+                values[1] = parameters.beta;
+                values[2] = parameters.derivativeCutoff;
+                break;
+            case FilterType::Kalman:
+                values[0] = parameters.processNoise;
+                values[1] = parameters.measurementNoise;
+                break;
+            case FilterType::None:
+                break;
+        }
+
+        const auto offset = std::ptrdiff_t(slot.offset);
+        std::fill_n(bank.parameter0.begin() + offset, Components, values[0]);
+        std::fill_n(bank.parameter1.begin() + offset, Components, values[1]);
+        std::fill_n(bank.parameter2.begin() + offset, Components, values[2]);
+
+        // Keep the state of the devices that were already filtered
+        for (const Slot& old : oldSlots) {
+            if (old.serialNumber != slot.serialNumber || old.type != slot.type
+                || old.reset) {
+                continue;
+            }
+
+            const Bank& oldBank = oldBanks[size_t(old.type)];
+            const auto copy = [&](const std::vector<double>& from,
+                                  std::vector<double>& to) {
+                std::copy_n(from.begin() + old.offset,
+                            Components,
+                            to.begin() + slot.offset);
+            };
+
+            copy(oldBank.value, bank.value);
+            copy(oldBank.state0, bank.state0);
+            copy(oldBank.state1, bank.state1);
+            copy(oldBank.state2, bank.state2);
+            copy(oldBank.state3, bank.state3);
+            slot.reset = false;
+            break;
+        }
+    }
+
+    m_layoutDirty = false;
+}
+
+void openvr::PosesFilter::resetSignals(const Slot& slot)
+{
+    Bank& bank = m_banks[size_t(slot.type)];
+
+    for (size_t i = slot.offset; i < slot.offset + Components; ++i) {
+        bank.value[i] = bank.measurement[i];
+        bank.state0[i] = 0;
+        bank.state1[i] = 0;
+        bank.state2[i] = 0;
+        bank.state3[i] = 0;
+
+        if (slot.type == FilterType::Kalman) {
+            bank.state1[i] = bank.parameter1[i] * bank.parameter1[i];
+            bank.state3[i] = InitialVelocityVariance;
+        }
+    }
+}
+
+void openvr::PosesFilter::runFilters(const double dt)
+{
+    this->runExponential(m_banks[size_t(FilterType::Exponential)], dt);
+    this->runOneEuro(m_banks[size_t(FilterType::OneEuro)], dt);
+    this->runKalman(m_banks[size_t(FilterType::Kalman)], dt);
+}
+
+void openvr::PosesFilter::runExponential(Bank& bank, const double dt) const
+{
+    const size_t size = Components * bank.devices;
+    const double* z = bank.measurement.data();
+    const double* timeConstant = bank.parameter0.data();
+    double* x = bank.value.data();
+
+    for (size_t i = 0; i < size; ++i) {
+        const double alpha = 1 - std::exp(-dt / timeConstant[i]);
+        x[i] += alpha * (z[i] - x[i]);
+    }
+}
+
+void openvr::PosesFilter::runOneEuro(Bank& bank, const double dt) const
+{
+    const size_t size = Components * bank.devices;
+    const double* z = bank.measurement.data();
+    const double* minCutoff = bank.parameter0.data();
+    const double* beta = bank.parameter1.data();
+    const double* derivativeCutoff = bank.parameter2.data();
+    double* x = bank.value.data();
+    double* dx = bank.state0.data();
+
+    for (size_t i = 0; i < size; ++i) {
+        const double rate = (z[i] - x[i]) / dt;
+        dx[i] += Alpha(derivativeCutoff[i], dt) * (rate - dx[i]);
+
+        const double cutoff = minCutoff[i] + beta[i] * std::abs(dx[i]);
+        x[i] += Alpha(cutoff, dt) * (z[i] - x[i]);
+    }
+}
+
+void openvr::PosesFilter::runKalman(Bank& bank, const double dt) const
+{
+    const size_t size = Components * bank.devices;
+    const double* z = bank.measurement.data();
+    const double* processNoise = bank.parameter0.data();
+    const double* measurementNoise = bank.parameter1.data();
+    double* x = bank.value.data();
+    double* v = bank.state0.data();
+    double* p00 = bank.state1.data();
+    double* p01 = bank.state2.data();
+    double* p11 = bank.state3.data();
+
+    const double dt2 = dt * dt;
+    const double dt3 = dt2 * dt;
+
+    for (size_t i = 0; i < size; ++i) {
+        // Prediction with constant velocity and white acceleration noise
+        x[i] += v[i] * dt;
+        const double q = processNoise[i];
+        const double a00 =
+            p00[i] + dt * (2 * p01[i] + dt * p11[i]) + q * dt3 / 3;
+        const double a01 = p01[i] + dt * p11[i] + q * dt2 / 2;
+        const double a11 = p11[i] + q * dt;
+
+        // Correction with the measured value
+        const double s = a00 + measurementNoise[i] * measurementNoise[i];
+        const double k0 = a00 / s;
+        const double k1 = a01 / s;
+        const double innovation = z[i] - x[i];
+
+        x[i] += k0 * innovation;
+        v[i] += k1 * innovation;
+        p00[i] = (1 - k0) * a00;
+        p01[i] = (1 - k0) * a01;
+        p11[i] = a11 - k1 * a01;
+    }
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2021 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef OPENVR_TRACKERS_POSES_FILTER_H
+#define OPENVR_TRACKERS_POSES_FILTER_H
+
+#include "OpenVRTrackersDriver.h"
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace openvr {
+    struct FilterParameters;
+    class PosesFilter;
+
+    enum class FilterType
+    {
+        None = 0,
+        // Exponential smoothing
+        Exponential = 1,
+        // One-Euro filter, adaptive low-pass filter whose cutoff frequency
+        // increases with the speed
+        OneEuro = 2,
+        // Kalman filter with a constant velocity model
+        Kalman = 3,
+    };
+} // namespace openvr
+
+struct openvr::FilterParameters
+{
+    FilterType type = FilterType::None;
+
+    // Exponential smoothing: time constant [s]
+    double timeConstant = 0.02;
+
+    // One-Euro filter: minimum cutoff frequency [Hz], increase of the cutoff
+    // frequency with the speed, and cutoff frequency of the speed [Hz]
+    double minCutoff = 1.0;
+    double beta = 0.0;
+    double derivativeCutoff = 1.0;
+
+    // Kalman filter: spectral density of the acceleration noise, and
+    // standard deviation of the measurement noise
+    double processNoise = 1.0;
+    double measurementNoise = 0.001;
+};
+
+/**
+ * Low-pass filter of the poses of the devices.
+ *
+ * The position and the orientation quaternion of each device are filtered
+ * as 7 independent signals, with the filter configured for its type. The
+ * signals of all the devices using the same filter are stored as contiguous
+ * arrays, so that each filter is a single loop over all of them per tick.
+ * Devices whose pose becomes valid again restart from the measured pose.
+ *
+ * The filter is not thread safe.
+ */
+class openvr::PosesFilter
+{
+public:
+    void setParameters(const TrackedDeviceType type,
+                       const FilterParameters& parameters);
+    FilterParameters parameters(const TrackedDeviceType type) const;
+
+    // True if any device type is filtered
+    bool enabled() const;
+    void reset();
+
+    // Copy `raw` to `filtered` replacing the poses with the filtered ones.
+    // Snapshots with the same timestamp of the previous one are not
+    // filtered again.
+    void apply(const DevicesSnapshot& raw, DevicesSnapshot& filtered);
+
+private:
+    // Position and quaternion (w, x, y, z)
+    static constexpr size_t Components = 7;
+
+    // Signals of the devices using the same filter, with the Components
+    // signals of each device stored consecutively
+    struct Bank
+    {
+        size_t devices = 0;
+
+        std::vector<double> measurement;
+        std::vector<double> value;
+
+        // Filter parameters, per signal
+        std::vector<double> parameter0;
+        std::vector<double> parameter1;
+        std::vector<double> parameter2;
+
+        // Filter state besides the value, per signal
+        std::vector<double> state0;
+        std::vector<double> state1;
+        std::vector<double> state2;
+        std::vector<double> state3;
+
+        void resize(const size_t size);
+    };
+
+    // Position of a device of the snapshot in the banks
+    struct Slot
+    {
+        std::string serialNumber;
+        FilterType type = FilterType::None;
+        size_t offset = 0;
+        bool reset = true;
+    };
+
+    static size_t TypeIndex(const TrackedDeviceType type);
+
+    bool layoutChanged(const DevicesSnapshot& raw) const;
+    void rebuild(const DevicesSnapshot& raw);
+    void resetSignals(const Slot& slot);
+    void runFilters(const double dt);
+    void runExponential(Bank& bank, const double dt) const;
+    void runOneEuro(Bank& bank, const double dt) const;
+    void runKalman(Bank& bank, const double dt) const;
+
+    // Parameters of HMDs, controllers and generic trackers
+    std::array<FilterParameters, 3> m_parameters = {};
+
+    // Indexed by FilterType, the None bank is unused
+    std::array<Bank, 4> m_banks;
+    std::vector<Slot> m_slots;
+    bool m_layoutDirty = true;
+
+    double m_lastTimestamp = 0;
+};
+
+#endif // OPENVR_TRACKERS_POSES_FILTER_H
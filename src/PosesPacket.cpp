@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2021 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include "PosesPacket.h"
+
+#include <yarp/os/LogStream.h>
+
+#include <cstring>
+
+namespace {
+    // Names longer than the capacity are truncated
+    void CopyName(char* destination, const std::string& name)
+    {
+        std::strncpy(destination,
+                     name.c_str(),
+                     openvr::DeviceName::NameCapacity - 1);
+        destination[openvr::DeviceName::NameCapacity - 1] = '\0';
+    }
+
+    bool SameName(const char* stored, const std::string& name)
+    {
+        return std::strncmp(stored,
+                            name.c_str(),
+                            openvr::DeviceName::NameCapacity - 1)
+               == 0;
+    }
+} // namespace
+
+bool openvr::PosesLayout::update(const DevicesSnapshot& snapshot)
+{
+    bool changed = snapshot.size != size;
+
+    for (size_t i = 0; i < snapshot.size && !changed; ++i) {
+        const DeviceState& state = snapshot.devices[i];
+        const DeviceName& name = names[i];
+
+        changed = name.index != state.index
+                  || !SameName(name.serialNumber, state.serialNumber)
+                  || !SameName(name.frameName, state.frameName);
+    }
+
+    if (!changed) {
+        return false;
+    }
+
+    size = snapshot.size;
+    for (size_t i = 0; i < size; ++i) {
+        const DeviceState& state = snapshot.devices[i];
+        DeviceName& name = names[i];
+
+        name.index = uint32_t(state.index);
+        name.reserved = 0;
+        CopyName(name.serialNumber, state.serialNumber);
+        CopyName(name.frameName, state.frameName);
+    }
+
+    counter++;
+    return true;
+}
+
+bool openvr::PosesPacket::read(yarp::os::ConnectionReader& reader)
+{
+    size = 0;
+    namesSize = 0;
+
+    if (reader.expectInt32() != Magic) {
+        yError() << "Received an invalid poses packet";
+        return false;
+    }
+
+    if (const int32_t version = reader.expectInt32(); version != Version) {
+        yError() << "Received a poses packet with unsupported version"
+                 << version;
+        return false;
+    }
+
+    layout = uint32_t(reader.expectInt32());
+    const int32_t count = reader.expectInt32();
+    const int32_t namesCount = reader.expectInt32();
+
+    if (count < 0 || size_t(count) > records.size() || namesCount < 0
+        || size_t(namesCount) > names.size()) {
+        yError() << "Received a poses packet with" << count << "records and"
+                 << namesCount << "names";
+        return false;
+    }
+
+    if (!reader.expectBlock(reinterpret_cast<char*>(records.data()),
+                            sizeof(PoseRecord) * size_t(count))) {
+        return false;
+    }
+
+    if (namesCount > 0
+        && !reader.expectBlock(reinterpret_cast<char*>(names.data()),
+                               sizeof(DeviceName) * size_t(namesCount))) {
+        return false;
+    }
+
+    size = size_t(count);
+    namesSize = size_t(namesCount);
+    return !reader.isError();
+}
+
+bool openvr::PosesPacket::write(yarp::os::ConnectionWriter& writer) const
+{
+    writer.appendInt32(Magic);
+    writer.appendInt32(Version);
+    writer.appendInt32(int32_t(layout));
+    writer.appendInt32(int32_t(size));
+    writer.appendInt32(int32_t(namesSize));
+    writer.appendExternalBlock(reinterpret_cast<const char*>(records.data()),
+                               sizeof(PoseRecord) * size);
+    if (namesSize > 0) {
+        writer.appendExternalBlock(
+            reinterpret_cast<const char*>(names.data()),
+            sizeof(DeviceName) * namesSize);
+    }
+
+    return !writer.isError();
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2021 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef OPENVR_TRACKERS_POSES_PACKET_H
+#define OPENVR_TRACKERS_POSES_PACKET_H
+
+#include "OpenVRTrackersDriver.h"
+
+#include <yarp/os/ConnectionReader.h>
+#include <yarp/os/ConnectionWriter.h>
+#include <yarp/os/Portable.h>
+
+#include <array>
+#include <cstdint>
+#include <type_traits>
+
+namespace openvr {
+    struct PoseRecord;
+    struct DeviceName;
+    struct PosesLayout;
+    class PosesPacket;
+} // namespace openvr
+
+/**
+ * Fixed-layout state of a device streamed by PosesPacket.
+ */
+struct openvr::PoseRecord
+{
+    uint32_t index;
+    uint32_t type;
+    // The pose and the velocities are zero when not valid
+    uint32_t valid;
+    uint32_t trackingResult;
+    // Time the pose refers to, including the prediction [s]
+    double timestamp;
+    double position[3];
+    // Unit quaternion in (w, x, y, z) order
+    double quaternion[4];
+    double linearVelocity[3];
+    double angularVelocity[3];
+};
+
+/**
+ * Names of the device with the given index, see PosesLayout.
+ */
+struct openvr::DeviceName
+{
+    static constexpr size_t NameCapacity = 128;
+
+    uint32_t index;
+    uint32_t reserved;
+    char serialNumber[NameCapacity];
+    char frameName[NameCapacity];
+};
+
+/**
+ * Names of the devices of the poses stream.
+ *
+ * The names do not change between the ticks, therefore they are not part
+ * of the records. The counter is incremented every time the devices or
+ * their frame names change, so that consumers can tell whether the names
+ * they received last still apply to the records.
+ */
+struct openvr::PosesLayout
+{
+    uint32_t counter = 0;
+    size_t size = 0;
+    std::array<DeviceName, MaxTrackedDevices> names = {};
+
+    // Update the names with the devices of the snapshot, in its order. It
+    // returns true and increments the counter when they changed.
+    bool update(const DevicesSnapshot& snapshot);
+};
+
+/**
+ * Binary message containing the state of all the devices.
+ *
+ * The wire format is a header of five int32 (magic, version, layout
+ * counter, number of records, number of names) followed by the PoseRecord
+ * array and by the DeviceName array, both in the native memory layout.
+ * The names are only sent when the layout changes and periodically for the
+ * consumers connecting later, the other packets contain no names. The
+ * records are written without intermediate copies, therefore the packet
+ * must not be modified while a port is writing it (which is the case when
+ * it is obtained from yarp::os::BufferedPort::prepare()).
+ */
+class openvr::PosesPacket final : public yarp::os::Portable
+{
+public:
+    static constexpr int32_t Magic = 0x4f565250; // "OVRP"
+    static constexpr int32_t Version = 2;
+
+    // Counter of the PosesLayout the records refer to
+    uint32_t layout = 0;
+
+    size_t size = 0;
+    std::array<PoseRecord, MaxTrackedDevices> records = {};
+
+    // Zero when the packet does not contain the names of the layout
+    size_t namesSize = 0;
+    std::array<DeviceName, MaxTrackedDevices> names = {};
+
+    bool read(yarp::os::ConnectionReader& reader) override;
+    bool write(yarp::os::ConnectionWriter& writer) const override;
+};
+
+static_assert(std::is_trivially_copyable_v<openvr::PoseRecord>);
+static_assert(std::is_trivially_copyable_v<openvr::DeviceName>);
+
+#endif // OPENVR_TRACKERS_POSES_PACKET_H
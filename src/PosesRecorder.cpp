@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2021 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include "PosesRecorder.h"
+
+#include <yarp/os/LogStream.h>
+
+#include <utility>
+
+openvr::PosesRecorder::~PosesRecorder()
+{
+    if (this->recording()) {
+        this->stop();
+    }
+}
+
+bool openvr::PosesRecorder::start(const std::string& path,
+                                  const uint32_t stages)
+{
+    if (this->recording()) {
+        yError() << "The poses are already being recorded";
+        return false;
+    }
+
+    // Never overwrite previous recordings
+    if (std::ifstream(path).good()) {
+        yError() << "Failed to record the poses," << path << "already exists";
+        return false;
+    }
+
+    m_file.open(path, std::ios::out | std::ios::binary);
+
+    const FileHeader header = {
+        FileMagic, Version, sizeof(PoseRecord), stages};
+    m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    if (!m_file) {
+        yError() << "Failed to open" << path;
+        m_file.close();
+        return false;
+    }
+
+    // Allocate the blocks once
+    for (Block* block : {&m_front, &m_back}) {
+        block->data.clear();
+        block->data.reserve(BlockCapacity);
+        block->ticks = 0;
+    }
+
+    m_backReady = false;
+    m_stopping = false;
+    m_ticks = 0;
+    m_dropped = 0;
+    m_failed = false;
+
+    m_writer = std::thread(&PosesRecorder::writerLoop, this);
+    m_recording = true;
+
+    yInfo() << "Recording the poses to" << path;
+    return true;
+}
+
+bool openvr::PosesRecorder::stop()
+{
+    if (!m_recording.exchange(false)) {
+        yError() << "The poses are not being recorded";
+        return false;
+    }
+
+    {
+        auto lock = std::unique_lock(m_mutex);
+
+        // Wait the writer to release the back block, then hand over the
+        // last ticks
+        m_condition.wait(lock, [this]() { return !m_backReady; });
+
+        if (!m_front.data.empty()) {
+            this->handOver();
+        }
+
+        m_stopping = true;
+        m_condition.notify_all();
+    }
+
+    m_writer.join();
+    m_file.close();
+
+    yInfo() << "Recorded" << m_ticks << "ticks," << m_dropped << "dropped";
+    return !m_failed;
+}
+
+bool openvr::PosesRecorder::recording() const
+{
+    return m_recording;
+}
+
+void openvr::PosesRecorder::record(const PosesPacket& packet,
+                                   const PosesLayout& layout,
+                                   const double timestamp,
+                                   const double acquisitionTimestamp)
+{
+    if (!m_recording) {
+        return;
+    }
+
+    // The space for the names is reserved even when they are not written
+    const size_t bytes = sizeof(TickHeader) + sizeof(PoseRecord) * packet.size
+                         + sizeof(DeviceName) * layout.size;
+    const auto now = std::chrono::steady_clock::now();
+    const auto lock = std::unique_lock(m_mutex);
+
+    // Send the block to the writer when full or old enough. If the writer
+    // is still busy, keep filling it while there is space.
+    if (!m_front.data.empty()
+        && (m_front.data.size() + bytes > BlockCapacity
+            || now - m_front.created >= FlushPeriod)) {
+        this->handOver();
+    }
+
+    if (m_front.data.size() + bytes > BlockCapacity) {
+        m_dropped++;
+        return;
+    }
+
+    // Each chunk starts with the table of the names
+    const bool withNames =
+        m_front.data.empty() || layout.counter != m_layout;
+
+    if (m_front.data.empty()) {
+        m_front.created = now;
+    }
+
+    const size_t names = withNames ? layout.size : 0;
+    m_layout = layout.counter;
+
+    const TickHeader header = {timestamp,
+                               acquisitionTimestamp,
+                               uint32_t(packet.size),
+                               uint32_t(names)};
+    const char* headerBytes = reinterpret_cast<const char*>(&header);
+    const char* recordsBytes =
+        reinterpret_cast<const char*>(packet.records.data());
+    const char* namesBytes = reinterpret_cast<const char*>(layout.names.data());
+
+    // The capacity was reserved, no allocation occurs
+    m_front.data.insert(
+        m_front.data.end(), headerBytes, headerBytes + sizeof(header));
+    m_front.data.insert(m_front.data.end(),
+                        recordsBytes,
+                        recordsBytes + sizeof(PoseRecord) * packet.size);
+    m_front.data.insert(m_front.data.end(),
+                        namesBytes,
+                        namesBytes + sizeof(DeviceName) * names);
+    m_front.ticks++;
+    m_ticks++;
+}
+
+// ===============
+// Private methods
+// ===============
+
+bool openvr::PosesRecorder::handOver()
+{
+    if (m_backReady) {
+        return false;
+    }
+
+    std::swap(m_front, m_back);
+    m_front.data.clear();
+    m_front.ticks = 0;
+
+    m_backReady = true;
+    m_condition.notify_all();
+    return true;
+}
+
+void openvr::PosesRecorder::writerLoop()
+{
+    auto lock = std::unique_lock(m_mutex);
+
+    while (true) {
+        m_condition.wait(lock,
+                         [this]() { return m_backReady || m_stopping; });
+
+        if (!m_backReady) {
+            break;
+        }
+
+        // The back block is owned by this thread until m_backReady is reset
+        lock.unlock();
+
+        const ChunkHeader header = {
+            ChunkMagic, m_back.ticks, uint64_t(m_back.data.size())};
+        m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        m_file.write(m_back.data.data(), std::streamsize(m_back.data.size()));
+        m_file.flush();
+
+        if (!m_file && !m_failed.exchange(true)) {
+            yError() << "Failed to write the recorded poses";
+        }
+
+        lock.lock();
+        m_backReady = false;
+        m_condition.notify_all();
+    }
+}
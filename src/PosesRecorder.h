@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2021 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef OPENVR_TRACKERS_POSES_RECORDER_H
+#define OPENVR_TRACKERS_POSES_RECORDER_H
+
+#include "PosesPacket.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace openvr {
+    class PosesRecorder;
+} // namespace openvr
+
+/**
+ * Append-only binary recording of the poses computed by the module.
+ *
+ * The file starts with a FileHeader followed by chunks. Each chunk is a
+ * ChunkHeader followed by its ticks, and each tick is a TickHeader followed
+ * by the PoseRecord array of the devices. The table of the names of the
+ * devices (the DeviceName array of the PosesLayout) follows the records of
+ * the first tick of each chunk, and of the ticks where the layout changed,
+ * so that every chunk can be read on its own. All the structures are
+ * written in the native memory layout. A recording interrupted abruptly
+ * loses at most the last chunk.
+ *
+ * The poses are recorded before the filters. The stages of the manager
+ * already applied to them, e.g. the frame offsets, are listed in the file
+ * header as they were when the recording started, so that a replay does
+ * not apply them twice.
+ *
+ * Ticks are copied in a memory block that is handed to a background thread
+ * when full or older than one second. While the thread writes a block, the
+ * ticks are copied in the other one, so that record() never waits for the
+ * disk. If both blocks are full, ticks are dropped and counted.
+ */
+class openvr::PosesRecorder
+{
+public:
+    static constexpr uint32_t FileMagic = 0x4f565252; // "OVRR"
+    static constexpr uint32_t ChunkMagic = 0x43484e4b; // "CHNK"
+    static constexpr uint32_t Version = 4;
+
+    // Stages applied to the recorded poses
+    static constexpr uint32_t FrameOffsetsStage = 1 << 0;
+    static constexpr uint32_t UniverseTransformStage = 1 << 1;
+
+    struct FileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t recordSize;
+        uint32_t stages;
+    };
+
+    struct ChunkHeader
+    {
+        uint32_t magic;
+        uint32_t ticks;
+        // Size of the ticks following the header
+        uint64_t bytes;
+    };
+
+    struct TickHeader
+    {
+        // Time the poses refer to, including the prediction [s]
+        double timestamp;
+        // Time the poses were fetched from the runtime [s]
+        double acquisitionTimestamp;
+        // Number of records following the header, and of names following
+        // the records, zero when the table of the names did not change
+        uint32_t size;
+        uint32_t names;
+    };
+
+    static constexpr size_t BlockCapacity = 4 * 1024 * 1024;
+    static constexpr std::chrono::seconds FlushPeriod{1};
+
+    PosesRecorder() = default;
+    PosesRecorder(const PosesRecorder&) = delete;
+    PosesRecorder& operator=(const PosesRecorder&) = delete;
+    ~PosesRecorder();
+
+    bool start(const std::string& path, const uint32_t stages);
+    bool stop();
+    bool recording() const;
+
+    // Called by a single thread, it does not wait for the disk
+    void record(const PosesPacket& packet,
+                const PosesLayout& layout,
+                const double timestamp,
+                const double acquisitionTimestamp);
+
+private:
+    struct Block
+    {
+        std::vector<char> data;
+        uint32_t ticks = 0;
+        std::chrono::steady_clock::time_point created;
+    };
+
+    void writerLoop();
+    bool handOver();
+
+    std::atomic<bool> m_recording = false;
+    std::ofstream m_file;
+    std::thread m_writer;
+
+    // Protects the blocks and the flags, never held while writing
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+
+    // Filled by record()
+    Block m_front;
+    // Written by the writer thread while m_backReady is true
+    Block m_back;
+    bool m_backReady = false;
+    bool m_stopping = false;
+
+    // Counter of the PosesLayout last written in m_front
+    uint32_t m_layout = 0;
+
+    uint64_t m_ticks = 0;
+    uint64_t m_dropped = 0;
+    std::atomic<bool> m_failed = false;
+};
+
+static_assert(std::is_trivially_copyable_v<openvr::PosesRecorder::TickHeader>);
+
+#endif // OPENVR_TRACKERS_POSES_RECORDER_H
@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2021 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include "Publication.h"
+
+#include <algorithm>
+
+void openvr::FillPosesPacket(const DevicesSnapshot& snapshot,
+                             const PosesLayout& layout,
+                             const bool withNames,
+                             PosesPacket& poses)
+{
+    poses.layout = layout.counter;
+    poses.namesSize = withNames ? layout.size : 0;
+    std::copy_n(layout.names.begin(), poses.namesSize, poses.names.begin());
+
+    poses.size = 0;
+
+    for (size_t i = 0; i < snapshot.size; ++i) {
+        const DeviceState& state = snapshot.devices[i];
+
+        PoseRecord& record = poses.records[poses.size++];
+        record.index = uint32_t(state.index);
+        record.type = uint32_t(state.type);
+        record.valid = state.valid ? 1 : 0;
+        record.trackingResult = uint32_t(state.pose.trackingResult);
+        record.timestamp = state.timestamp;
+
+        if (state.valid) {
+            const Pose& pose = state.pose;
+
+            for (size_t j = 0; j < 3; ++j) {
+                record.position[j] = pose.position[j];
+                record.linearVelocity[j] = pose.linearVelocity[j];
+                record.angularVelocity[j] = pose.angularVelocity[j];
+            }
+            for (size_t j = 0; j < 4; ++j) {
+                record.quaternion[j] = pose.quaternion[j];
+            }
+        }
+        else {
+            // The records are reused, never leave a stale pose
+            std::fill_n(record.position, 3, 0.0);
+            std::fill_n(record.quaternion, 4, 0.0);
+            std::fill_n(record.linearVelocity, 3, 0.0);
+            std::fill_n(record.angularVelocity, 3, 0.0);
+        }
+    }
+}
+
+void openvr::Publication::fill(const double time,
+                               const Snapshots& snapshots,
+                               const Messages& messages)
+{
+    // The names of the devices are sent when they change, and
+    // periodically for the consumers connecting later
+    bool withNames = m_layout.update(snapshots.poses);
+    if (withNames || time - m_lastLayoutTime >= LayoutPeriod) {
+        withNames = true;
+        m_lastLayoutTime = time;
+    }
+
+    if (messages.transforms) {
+        this->fillTransforms(snapshots.transforms, *messages.transforms);
+    }
+
+    if (messages.poses) {
+        FillPosesPacket(snapshots.poses, m_layout, withNames, *messages.poses);
+    }
+
+    if (messages.state) {
+        this->fillState(snapshots.state, *messages.state);
+    }
+}
+
+const openvr::PosesLayout& openvr::Publication::layout() const
+{
+    return m_layout;
+}
+
+void openvr::Publication::fillTransforms(const DevicesSnapshot& snapshot,
+                                         yarp::os::Bottle& transforms) const
+{
+    // The bottle contains one list per valid device with the following
+    // format: (parent child timestamp tx ty tz qw qx qy qz)
+    transforms.clear();
+
+    for (size_t i = 0; i < snapshot.size; ++i) {
+        const DeviceState& state = snapshot.devices[i];
+
+        if (!state.valid) {
+            continue;
+        }
+
+        const Pose& pose = state.pose;
+
+        yarp::os::Bottle& transform = transforms.addList();
+        transform.addString(baseFrame);
+        transform.addString(state.frameName);
+        transform.addFloat64(state.timestamp);
+        transform.addFloat64(pose.position[0]);
+        transform.addFloat64(pose.position[1]);
+        transform.addFloat64(pose.position[2]);
+        transform.addFloat64(pose.quaternion[0]);
+        transform.addFloat64(pose.quaternion[1]);
+        transform.addFloat64(pose.quaternion[2]);
+        transform.addFloat64(pose.quaternion[3]);
+    }
+}
+
+void openvr::Publication::fillState(const DevicesSnapshot& snapshot,
+                                    yarp::os::Bottle& state) const
+{
+    // The bottle contains one list per device with the following format:
+    // (serial type valid trackingResult timestamp
+    //  (position) (rotationRowMajor) (linearVelocity) (angularVelocity))
+    // where (rotationRowMajor) is replaced by (qw qx qy qz) when
+    // stateQuaternion is set
+    state.clear();
+
+    const auto addArray = [](yarp::os::Bottle& bottle, const auto& array) {
+        yarp::os::Bottle& list = bottle.addList();
+        for (const double value : array) {
+            list.addFloat64(value);
+        }
+    };
+
+    for (size_t i = 0; i < snapshot.size; ++i) {
+        const DeviceState& device = snapshot.devices[i];
+
+        yarp::os::Bottle& entry = state.addList();
+        entry.addString(device.serialNumber);
+        entry.addInt32(int32_t(device.type));
+        entry.addInt32(device.valid ? 1 : 0);
+        entry.addInt32(int32_t(device.pose.trackingResult));
+        entry.addFloat64(device.timestamp);
+        addArray(entry, device.pose.position);
+        if (stateQuaternion) {
+            addArray(entry, device.pose.quaternion);
+        }
+        else {
+            addArray(entry, device.pose.rotationRowMajor);
+        }
+        addArray(entry, device.pose.linearVelocity);
+        addArray(entry, device.pose.angularVelocity);
+    }
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2021 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef OPENVR_TRACKERS_PUBLICATION_H
+#define OPENVR_TRACKERS_PUBLICATION_H
+
+#include "OpenVRTrackersDriver.h"
+#include "PosesPacket.h"
+
+#include <yarp/os/Bottle.h>
+
+#include <string>
+
+namespace openvr {
+    class Publication;
+
+    // Fill the records of the given poses in the order of the snapshot,
+    // and the names of the layout when requested
+    void FillPosesPacket(const DevicesSnapshot& snapshot,
+                         const PosesLayout& layout,
+                         const bool withNames,
+                         PosesPacket& poses);
+} // namespace openvr
+
+/**
+ * Messages published in a cycle of the module, filled from the snapshots
+ * of the devices.
+ *
+ * The module writes the filled messages on its ports, the benchmarks run
+ * the same steps without them. The transforms sent one by one to the
+ * transformServer are not part of the publication.
+ *
+ * The publication is not thread safe.
+ */
+class openvr::Publication
+{
+public:
+    // Messages to fill, the null ones are skipped
+    struct Messages
+    {
+        // Batched transforms, one list per valid device
+        yarp::os::Bottle* transforms = nullptr;
+        PosesPacket* poses = nullptr;
+        yarp::os::Bottle* state = nullptr;
+    };
+
+    // Poses of each message, either raw or filtered, with the same devices
+    struct Snapshots
+    {
+        const DevicesSnapshot& transforms;
+        const DevicesSnapshot& poses;
+        const DevicesSnapshot& state;
+    };
+
+    // Period of the names of the devices in the poses packets [s]
+    static constexpr double LayoutPeriod = 1.0;
+
+    // Parent frame of the batched transforms
+    std::string baseFrame;
+
+    // Whether the state contains the orientation quaternion instead of the
+    // rotation matrix
+    bool stateQuaternion = false;
+
+    // Fill the messages of the cycle starting at the given time [s]. The
+    // layout is updated even when the poses are not published, since the
+    // recordings use it.
+    void fill(const double time,
+              const Snapshots& snapshots,
+              const Messages& messages);
+
+    // Names of the devices of the last filled poses
+    const PosesLayout& layout() const;
+
+private:
+    void fillTransforms(const DevicesSnapshot& snapshot,
+                        yarp::os::Bottle& transforms) const;
+    void fillState(const DevicesSnapshot& snapshot,
+                   yarp::os::Bottle& state) const;
+
+    PosesLayout m_layout;
+    double m_lastLayoutTime = 0;
+};
+
+#endif // OPENVR_TRACKERS_PUBLICATION_H
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2021 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef OPENVR_TRACKERS_RCU_POINTER_H
+#define OPENVR_TRACKERS_RCU_POINTER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+namespace openvr {
+    template <typename T>
+    class RcuPointer;
+} // namespace openvr
+
+/**
+ * Immutable value published to lock-free readers (read-copy-update).
+ *
+ * Readers never take locks nor wait: they announce themselves in the
+ * counter of the current epoch and read the published pointer. The writer
+ * publishes a new value, starts a new epoch and destroys the replaced value
+ * once the readers of the previous epoch are done with it, so it is the
+ * only one waiting. Readers hold the value for the lifetime of a ReadGuard,
+ * which must be short and must never outlive the RcuPointer. A thread
+ * holding a ReadGuard must not call update().
+ */
+template <typename T>
+class openvr::RcuPointer
+{
+    static_assert(std::atomic<const T*>::is_always_lock_free
+                      && std::atomic<uint64_t>::is_always_lock_free,
+                  "RcuPointer requires lock-free atomics");
+
+public:
+    class ReadGuard
+    {
+    public:
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+
+        ReadGuard(ReadGuard&& other) noexcept
+            : m_readers(other.m_readers)
+            , m_value(other.m_value)
+        {
+            other.m_readers = nullptr;
+        }
+
+        ~ReadGuard()
+        {
+            if (m_readers) {
+                m_readers->fetch_sub(1);
+            }
+        }
+
+        const T* operator->() const { return m_value; }
+        const T& operator*() const { return *m_value; }
+
+    private:
+        friend class RcuPointer;
+
+        ReadGuard(std::atomic<uint64_t>& readers, const T* value)
+            : m_readers(&readers)
+            , m_value(value)
+        {}
+
+        std::atomic<uint64_t>* m_readers;
+        const T* m_value;
+    };
+
+    explicit RcuPointer(std::unique_ptr<const T> value)
+        : m_value(value.release())
+    {}
+
+    RcuPointer(const RcuPointer&) = delete;
+    RcuPointer& operator=(const RcuPointer&) = delete;
+
+    ~RcuPointer() { delete m_value.load(); }
+
+    ReadGuard read() const
+    {
+        while (true) {
+            const uint64_t epoch = m_epoch.load();
+            std::atomic<uint64_t>& readers = m_readers[epoch % 2];
+            readers.fetch_add(1);
+
+            // The writer could have started a new epoch and checked the
+            // readers of this one before they were incremented
+            if (m_epoch.load() == epoch) {
+                return ReadGuard(readers, m_value.load());
+            }
+
+            readers.fetch_sub(1);
+        }
+    }
+
+    // Value of the writer. Must be called by a single thread at a time,
+    // as update().
+    const T& current() const { return *m_value.load(); }
+
+    // Must be called by a single thread at a time
+    void update(std::unique_ptr<const T> value)
+    {
+        const T* replaced = m_value.exchange(value.release());
+
+        // Readers of the new epoch read the new value, wait the ones of the
+        // previous epoch, which could still read the replaced value
+        const uint64_t epoch = m_epoch.fetch_add(1);
+        while (m_readers[epoch % 2].load() > 0) {
+            std::this_thread::yield();
+        }
+
+        delete replaced;
+    }
+
+private:
+    std::atomic<const T*> m_value;
+    std::atomic<uint64_t> m_epoch{0};
+    mutable std::array<std::atomic<uint64_t>, 2> m_readers = {};
+};
+
+#endif // OPENVR_TRACKERS_RCU_POINTER_H
@@ -0,0 +1,674 @@
+/*
+ * Copyright (C) 2021 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include "ReplayBackend.h"
+
+#include <yarp/os/LogStream.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    // Size of a tick including its header
+    size_t TickBytes(const openvr::PosesRecorder::TickHeader& header)
+    {
+        return sizeof(header) + sizeof(openvr::PoseRecord) * header.size
+               + sizeof(openvr::DeviceName) * header.names;
+    }
+
+    vr::TrackedDevicePose_t InvalidPose()
+    {
+        vr::TrackedDevicePose_t pose = {};
+        pose.eTrackingResult = vr::TrackingResult_Uninitialized;
+        pose.bPoseIsValid = false;
+        pose.bDeviceIsConnected = false;
+        return pose;
+    }
+
+    vr::TrackedDevicePose_t ToPose(const openvr::PoseRecord& record)
+    {
+        vr::TrackedDevicePose_t pose = {};
+        auto& m = pose.mDeviceToAbsoluteTracking.m;
+
+        const double w = record.quaternion[0];
+        const double x = record.quaternion[1];
+        const double y = record.quaternion[2];
+        const double z = record.quaternion[3];
+
+        m[0][0] = float(1 - 2 * (y * y + z * z));
+        m[0][1] = float(2 * (x * y - w * z));
+        m[0][2] = float(2 * (x * z + w * y));
+        m[1][0] = float(2 * (x * y + w * z));
+        m[1][1] = float(1 - 2 * (x * x + z * z));
+        m[1][2] = float(2 * (y * z - w * x));
+        m[2][0] = float(2 * (x * z - w * y));
+        m[2][1] = float(2 * (y * z + w * x));
+        m[2][2] = float(1 - 2 * (x * x + y * y));
+
+        for (size_t i = 0; i < 3; ++i) {
+            m[i][3] = float(record.position[i]);
+            pose.vVelocity.v[i] = float(record.linearVelocity[i]);
+            pose.vAngularVelocity.v[i] = float(record.angularVelocity[i]);
+        }
+
+        pose.eTrackingResult = vr::ETrackingResult(record.trackingResult);
+        pose.bPoseIsValid = record.valid != 0;
+        pose.bDeviceIsConnected = true;
+        return pose;
+    }
+} // namespace
+
+// ==========
+// MappedFile
+// ==========
+
+struct openvr::ReplayBackend::MappedFile
+{
+    const char* data = nullptr;
+    size_t size = 0;
+
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+
+    bool open(const std::string& path)
+    {
+        file = CreateFileA(path.c_str(),
+                           GENERIC_READ,
+                           FILE_SHARE_READ,
+                           nullptr,
+                           OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL,
+                           nullptr);
+
+        LARGE_INTEGER fileSize;
+        if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize)
+            || fileSize.QuadPart == 0) {
+            return false;
+        }
+
+        mapping = CreateFileMappingA(
+            file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) {
+            return false;
+        }
+
+        data = static_cast<const char*>(
+            MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        size = size_t(fileSize.QuadPart);
+        return data != nullptr;
+    }
+
+    ~MappedFile()
+    {
+        if (data) {
+            UnmapViewOfFile(data);
+        }
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        if (file != INVALID_HANDLE_VALUE) {
+            CloseHandle(file);
+        }
+    }
+#else
+    int descriptor = -1;
+
+    bool open(const std::string& path)
+    {
+        descriptor = ::open(path.c_str(), O_RDONLY);
+
+        struct stat status;
+        if (descriptor < 0 || fstat(descriptor, &status) != 0
+            || status.st_size == 0) {
+            return false;
+        }
+
+        void* address = mmap(nullptr,
+                             size_t(status.st_size),
+                             PROT_READ,
+                             MAP_PRIVATE,
+                             descriptor,
+                             0);
+        if (address == MAP_FAILED) {
+            return false;
+        }
+
+        data = static_cast<const char*>(address);
+        size = size_t(status.st_size);
+        return true;
+    }
+
+    ~MappedFile()
+    {
+        if (data) {
+            munmap(const_cast<char*>(data), size);
+        }
+        if (descriptor >= 0) {
+            close(descriptor);
+        }
+    }
+#endif
+};
+
+// =============
+// ReplayBackend
+// =============
+
+openvr::ReplayBackend::ReplayBackend(Options options)
+    : m_options(std::move(options))
+{}
+
+openvr::ReplayBackend::~ReplayBackend() = default;
+
+double openvr::ReplayBackend::duration() const
+{
+    const auto lock = std::unique_lock(m_mutex);
+    return m_endTime - m_startTime;
+}
+
+uint32_t openvr::ReplayBackend::stages() const
+{
+    const auto lock = std::unique_lock(m_mutex);
+    return m_stages;
+}
+
+double openvr::ReplayBackend::time() const
+{
+    const auto lock = std::unique_lock(m_mutex);
+    return m_cursorTime;
+}
+
+bool openvr::ReplayBackend::seek(const double time)
+{
+    const auto lock = std::unique_lock(m_mutex);
+
+    if (!m_running) {
+        yError() << "Failed to seek, the replay is not running";
+        return false;
+    }
+
+    this->seekLocked(time);
+    return true;
+}
+
+bool openvr::ReplayBackend::initialize()
+{
+    const auto lock = std::unique_lock(m_mutex);
+
+    if (m_running) {
+        yError() << "Replay runtime already initialized";
+        return false;
+    }
+
+    if (!(m_options.speed >= 0)) {
+        yError() << "Invalid replay speed" << m_options.speed;
+        return false;
+    }
+
+    if (!this->openFile()) {
+        m_file.reset();
+        m_chunks.clear();
+        return false;
+    }
+
+    m_running = true;
+    m_connected = 0;
+    m_pendingEvents.clear();
+    this->seekLocked(0);
+
+    yDebug() << "Replaying" << m_endTime - m_startTime << "s from"
+             << m_options.path;
+    return true;
+}
+
+void openvr::ReplayBackend::shutdown()
+{
+    const auto lock = std::unique_lock(m_mutex);
+
+    m_running = false;
+    m_file.reset();
+    m_chunks.clear();
+}
+
+bool openvr::ReplayBackend::running() const
+{
+    const auto lock = std::unique_lock(m_mutex);
+    return m_running;
+}
+
+bool openvr::ReplayBackend::isTrackedDeviceConnected(
+    const vr::TrackedDeviceIndex_t index) const
+{
+    const auto lock = std::unique_lock(m_mutex);
+    return index < m_records.size() && (m_connected >> index) & 1;
+}
+
+vr::ETrackedDeviceClass openvr::ReplayBackend::trackedDeviceClass(
+    const vr::TrackedDeviceIndex_t index) const
+{
+    const auto lock = std::unique_lock(m_mutex);
+
+    if (!this->isTrackedDeviceConnected(index)) {
+        return vr::TrackedDeviceClass_Invalid;
+    }
+
+    return vr::ETrackedDeviceClass(m_records[index].type);
+}
+
+std::string openvr::ReplayBackend::stringProperty(
+    const vr::TrackedDeviceIndex_t index,
+    const vr::ETrackedDeviceProperty property) const
+{
+    const auto lock = std::unique_lock(m_mutex);
+
+    if (!this->isTrackedDeviceConnected(index)) {
+        return {};
+    }
+
+    switch (property) {
+        case vr::Prop_SerialNumber_String:
+            return m_names[index].serialNumber;
+        case vr::Prop_ModelNumber_String:
+            return "Replay";
+        default:
+            return {};
+    }
+}
+
+int32_t openvr::ReplayBackend::int32Property(
+    const vr::TrackedDeviceIndex_t /*index*/,
+    const vr::ETrackedDeviceProperty /*property*/) const
+{
+    return 0;
+}
+
+float openvr::ReplayBackend::floatProperty(
+    const vr::TrackedDeviceIndex_t /*index*/,
+    const vr::ETrackedDeviceProperty /*property*/) const
+{
+    return 0;
+}
+
+bool openvr::ReplayBackend::boolProperty(
+    const vr::TrackedDeviceIndex_t /*index*/,
+    const vr::ETrackedDeviceProperty /*property*/) const
+{
+    return false;
+}
+
+void openvr::ReplayBackend::deviceToAbsoluteTrackingPose(
+    const vr::ETrackingUniverseOrigin /*origin*/,
+    const float /*predictedSecondsToPhotonsFromNow*/,
+    vr::TrackedDevicePose_t* poses,
+    const uint32_t count)
+{
+    const auto lock = std::unique_lock(m_mutex);
+
+    // As fast as possible, every read returns the next tick
+    const bool stepped = m_options.speed == 0;
+
+    if (!stepped) {
+        this->update(false);
+    }
+
+    for (uint32_t index = 0; index < count; ++index) {
+        poses[index] = this->isTrackedDeviceConnected(index)
+                           ? ToPose(m_records[index])
+                           : InvalidPose();
+    }
+
+    if (stepped) {
+        this->update(true);
+    }
+}
+
+bool openvr::ReplayBackend::timeSinceLastVsync(float& /*seconds*/,
+                                               uint64_t& /*frameCounter*/) const
+{
+    return false;
+}
+
+bool openvr::ReplayBackend::pollNextEvent(vr::VREvent_t& event)
+{
+    const auto lock = std::unique_lock(m_mutex);
+
+    if (m_options.speed > 0) {
+        this->update(false);
+    }
+
+    if (m_pendingEvents.empty()) {
+        return false;
+    }
+
+    event = m_pendingEvents.front();
+    m_pendingEvents.pop_front();
+    return true;
+}
+
+void openvr::ReplayBackend::acknowledgeQuit() {}
+
+void openvr::ReplayBackend::resetZeroPose(
+    const vr::ETrackingUniverseOrigin /*origin*/)
+{}
+
+// ===============
+// Private methods
+// ===============
+
+bool openvr::ReplayBackend::openFile()
+{
+    m_file = std::make_unique<MappedFile>();
+    m_chunks.clear();
+
+    if (!m_file->open(m_options.path)) {
+        yError() << "Failed to map the recording" << m_options.path;
+        return false;
+    }
+
+    const char* data = m_file->data;
+    const size_t size = m_file->size;
+
+    PosesRecorder::FileHeader header;
+    if (size < sizeof(header)) {
+        yError() << m_options.path << "is not a poses recording";
+        return false;
+    }
+
+    std::memcpy(&header, data, sizeof(header));
+
+    if (header.magic != PosesRecorder::FileMagic
+        || header.version != PosesRecorder::Version
+        || header.recordSize != sizeof(PoseRecord)) {
+        yError() << m_options.path
+                 << "is not a poses recording with a supported version";
+        return false;
+    }
+
+    m_stages = header.stages;
+
+    // Index the chunks reading only their headers
+    size_t offset = sizeof(header);
+
+    while (offset + sizeof(PosesRecorder::ChunkHeader) <= size) {
+        PosesRecorder::ChunkHeader chunk;
+        std::memcpy(&chunk, data + offset, sizeof(chunk));
+        offset += sizeof(chunk);
+
+        if (chunk.magic != PosesRecorder::ChunkMagic
+            || chunk.bytes > size - offset
+            || chunk.bytes < sizeof(PosesRecorder::TickHeader)) {
+            yWarning() << "The recording" << m_options.path
+                       << "is truncated, ignoring its last bytes";
+            break;
+        }
+
+        if (chunk.ticks > 0) {
+            PosesRecorder::TickHeader first;
+            std::memcpy(&first, data + offset, sizeof(first));
+            m_chunks.push_back({offset,
+                                size_t(chunk.bytes),
+                                chunk.ticks,
+                                first.acquisitionTimestamp});
+        }
+
+        offset += size_t(chunk.bytes);
+    }
+
+    if (m_chunks.empty()) {
+        yError() << "The recording" << m_options.path << "is empty";
+        return false;
+    }
+
+    // Find the time of the last tick
+    Cursor cursor;
+    cursor.chunk = m_chunks.size() - 1;
+    cursor.offset = m_chunks.back().offset;
+    while (this->next(cursor)) {
+    }
+
+    m_startTime = m_chunks.front().time;
+    m_endTime = this->tickHeader(cursor).acquisitionTimestamp;
+    return true;
+}
+
+openvr::PosesRecorder::TickHeader
+openvr::ReplayBackend::tickHeader(const Cursor& cursor) const
+{
+    PosesRecorder::TickHeader header;
+    std::memcpy(&header, m_file->data + cursor.offset, sizeof(header));
+    return header;
+}
+
+bool openvr::ReplayBackend::next(Cursor& cursor) const
+{
+    const Chunk& chunk = m_chunks[cursor.chunk];
+
+    if (cursor.tick + 1 >= chunk.ticks) {
+        if (cursor.chunk + 1 >= m_chunks.size()) {
+            return false;
+        }
+
+        cursor.chunk++;
+        cursor.tick = 0;
+        cursor.offset = m_chunks[cursor.chunk].offset;
+        return true;
+    }
+
+    // Ticks not fitting in their chunk are considered the end of it
+    const size_t end = chunk.offset + chunk.bytes;
+    const size_t offset =
+        cursor.offset + TickBytes(this->tickHeader(cursor));
+
+    if (offset + sizeof(PosesRecorder::TickHeader) > end) {
+        return false;
+    }
+
+    Cursor candidate = cursor;
+    candidate.tick++;
+    candidate.offset = offset;
+
+    if (candidate.offset + TickBytes(this->tickHeader(candidate)) > end) {
+        return false;
+    }
+
+    cursor = candidate;
+    return true;
+}
+
+uint64_t openvr::ReplayBackend::devicesMask(const Cursor& cursor) const
+{
+    const size_t size = this->tickHeader(cursor).size;
+    const char* records =
+        m_file->data + cursor.offset + sizeof(PosesRecorder::TickHeader);
+
+    uint64_t mask = 0;
+    for (size_t i = 0; i < size; ++i) {
+        uint32_t index;
+        std::memcpy(&index,
+                    records + sizeof(PoseRecord) * i
+                        + offsetof(PoseRecord, index),
+                    sizeof(index));
+
+        if (index < m_records.size()) {
+            mask |= uint64_t(1) << index;
+        }
+    }
+
+    return mask;
+}
+
+void openvr::ReplayBackend::moveTo(const Cursor& cursor)
+{
+    const uint64_t connected = this->devicesMask(cursor);
+    const uint64_t changed = connected ^ m_connected;
+
+    // Notify the devices that appeared or disappeared
+    for (uint32_t index = 0; index < m_records.size(); ++index) {
+        if ((changed >> index) & 1) {
+            vr::VREvent_t event = {};
+            event.eventType = (connected >> index) & 1
+                                  ? vr::VREvent_TrackedDeviceActivated
+                                  : vr::VREvent_TrackedDeviceDeactivated;
+            event.trackedDeviceIndex = index;
+            m_pendingEvents.push_back(event);
+        }
+    }
+
+    // The names must be known when the events are processed
+    this->loadNames(cursor);
+
+    m_connected = connected;
+    m_cursor = cursor;
+    m_cursorTime = this->tickHeader(cursor).acquisitionTimestamp - m_startTime;
+}
+
+void openvr::ReplayBackend::loadNames(const Cursor& cursor)
+{
+    const PosesRecorder::TickHeader header = this->tickHeader(cursor);
+    const char* names = m_file->data + cursor.offset
+                        + sizeof(PosesRecorder::TickHeader)
+                        + sizeof(PoseRecord) * header.size;
+
+    for (size_t i = 0; i < header.names; ++i) {
+        DeviceName name;
+        std::memcpy(&name, names + sizeof(DeviceName) * i, sizeof(name));
+
+        if (name.index < m_names.size()) {
+            m_names[name.index] = name;
+        }
+    }
+}
+
+void openvr::ReplayBackend::loadRecords()
+{
+    const PosesRecorder::TickHeader header = this->tickHeader(m_cursor);
+    const char* records =
+        m_file->data + m_cursor.offset + sizeof(PosesRecorder::TickHeader);
+
+    for (size_t i = 0; i < header.size; ++i) {
+        PoseRecord record;
+        std::memcpy(&record, records + sizeof(PoseRecord) * i, sizeof(record));
+
+        if (record.index < m_records.size()) {
+            m_records[record.index] = record;
+        }
+    }
+}
+
+void openvr::ReplayBackend::seekLocked(const double time)
+{
+    const double target = m_startTime + std::max(0.0, time);
+
+    // Find the last chunk starting before the target time
+    const auto it = std::upper_bound(
+        m_chunks.begin(),
+        m_chunks.end(),
+        target,
+        [](const double t, const Chunk& chunk) { return t < chunk.time; });
+
+    Cursor cursor;
+    cursor.chunk = it == m_chunks.begin()
+                       ? 0
+                       : size_t(std::distance(m_chunks.begin(), it)) - 1;
+    cursor.offset = m_chunks[cursor.chunk].offset;
+
+    // Find the last tick before the target time within the chunk. The
+    // table of the names is written at the start of the chunk and when the
+    // layout changes, load all the tables up to the tick.
+    this->loadNames(cursor);
+
+    Cursor candidate = cursor;
+    while (this->next(candidate)
+           && this->tickHeader(candidate).acquisitionTimestamp <= target) {
+        cursor = candidate;
+        this->loadNames(cursor);
+    }
+
+    this->moveTo(cursor);
+    this->loadRecords();
+
+    m_finished = false;
+    m_originTime = m_cursorTime;
+    m_originWallTime = std::chrono::steady_clock::now();
+}
+
+void openvr::ReplayBackend::update(const bool step)
+{
+    if (!m_running || m_finished) {
+        return;
+    }
+
+    const double target =
+        m_originTime
+        + m_options.speed
+              * std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                              - m_originWallTime)
+                    .count();
+
+    bool moved = false;
+
+    while (true) {
+        Cursor cursor = m_cursor;
+
+        if (!this->next(cursor)) {
+            if (!m_options.loop) {
+                // Disconnect all the devices
+                m_finished = true;
+                for (uint32_t index = 0; index < m_records.size(); ++index) {
+                    if ((m_connected >> index) & 1) {
+                        vr::VREvent_t event = {};
+                        event.eventType = vr::VREvent_TrackedDeviceDeactivated;
+                        event.trackedDeviceIndex = index;
+                        m_pendingEvents.push_back(event);
+                    }
+                }
+                m_connected = 0;
+                return;
+            }
+
+            // Restart the recording, its clock starts again from now
+            this->seekLocked(0);
+            return;
+        }
+
+        const double time =
+            this->tickHeader(cursor).acquisitionTimestamp - m_startTime;
+
+        if (!step && time > target) {
+            break;
+        }
+
+        // Intermediate ticks only generate the events
+        this->moveTo(cursor);
+        moved = true;
+
+        if (step) {
+            break;
+        }
+    }
+
+    if (moved) {
+        this->loadRecords();
+    }
+}
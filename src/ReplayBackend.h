@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2021 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef OPENVR_TRACKERS_REPLAY_BACKEND_H
+#define OPENVR_TRACKERS_REPLAY_BACKEND_H
+
+#include "PosesRecorder.h"
+#include "TrackingBackend.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace openvr {
+    class ReplayBackend;
+} // namespace openvr
+
+/**
+ * Tracking backend replaying a file written by PosesRecorder.
+ *
+ * The file is memory-mapped and only an index of its chunks is kept in
+ * memory, so that recordings of any length can be replayed and seeked.
+ * Devices recorded in a tick are connected, and the runtime events are
+ * generated when devices appear or disappear between consecutive ticks.
+ * The recorded poses are returned as they are, ignoring the prediction.
+ * Properties other than the serial number, e.g. the roles, are not recorded.
+ *
+ * The recording is replayed with the given speed relative to the original
+ * one. With zero speed, it is replayed as fast as possible, advancing by one
+ * tick every time the poses are read. When the recording ends, all the
+ * devices are disconnected, unless the replay loops.
+ */
+class openvr::ReplayBackend final : public openvr::TrackingBackend
+{
+public:
+    struct Options
+    {
+        std::string path;
+        double speed = 1.0;
+        bool loop = false;
+    };
+
+    explicit ReplayBackend(Options options);
+    ~ReplayBackend() override;
+
+    // Duration of the recording [s]
+    double duration() const;
+    // Time of the replayed tick from the start of the recording [s]
+    double time() const;
+    bool seek(const double time);
+    // Stages of the manager already applied to the recorded poses, see
+    // PosesRecorder. Known once initialized.
+    uint32_t stages() const;
+
+    bool initialize() override;
+    void shutdown() override;
+    bool running() const override;
+
+    bool isTrackedDeviceConnected(
+        const vr::TrackedDeviceIndex_t index) const override;
+    vr::ETrackedDeviceClass
+    trackedDeviceClass(const vr::TrackedDeviceIndex_t index) const override;
+    std::string
+    stringProperty(const vr::TrackedDeviceIndex_t index,
+                   const vr::ETrackedDeviceProperty property) const override;
+    int32_t
+    int32Property(const vr::TrackedDeviceIndex_t index,
+                  const vr::ETrackedDeviceProperty property) const override;
+    float
+    floatProperty(const vr::TrackedDeviceIndex_t index,
+                  const vr::ETrackedDeviceProperty property) const override;
+    bool
+    boolProperty(const vr::TrackedDeviceIndex_t index,
+                 const vr::ETrackedDeviceProperty property) const override;
+
+    void
+    deviceToAbsoluteTrackingPose(const vr::ETrackingUniverseOrigin origin,
+                                 const float predictedSecondsToPhotonsFromNow,
+                                 vr::TrackedDevicePose_t* poses,
+                                 const uint32_t count) override;
+
+    bool timeSinceLastVsync(float& seconds,
+                            uint64_t& frameCounter) const override;
+
+    bool pollNextEvent(vr::VREvent_t& event) override;
+    void acknowledgeQuit() override;
+
+    void resetZeroPose(const vr::ETrackingUniverseOrigin origin) override;
+
+private:
+    struct MappedFile;
+
+    struct Chunk
+    {
+        // Offset of the first tick in the file
+        size_t offset;
+        size_t bytes;
+        uint32_t ticks;
+        // Acquisition time of the first tick [s]
+        double time;
+    };
+
+    // Position of a tick in the file
+    struct Cursor
+    {
+        size_t chunk = 0;
+        uint32_t tick = 0;
+        size_t offset = 0;
+    };
+
+    bool openFile();
+    PosesRecorder::TickHeader tickHeader(const Cursor& cursor) const;
+    bool next(Cursor& cursor) const;
+    uint64_t devicesMask(const Cursor& cursor) const;
+    void moveTo(const Cursor& cursor);
+    void loadNames(const Cursor& cursor);
+    void loadRecords();
+    void seekLocked(const double time);
+    void update(const bool step);
+
+    Options m_options;
+    std::unique_ptr<MappedFile> m_file;
+    std::vector<Chunk> m_chunks;
+    double m_startTime = 0;
+    double m_endTime = 0;
+    uint32_t m_stages = 0;
+
+    bool m_running = false;
+    bool m_finished = false;
+    Cursor m_cursor;
+    double m_cursorTime = 0;
+
+    // The replay time advances from the given origin with the wall clock
+    double m_originTime = 0;
+    std::chrono::steady_clock::time_point m_originWallTime;
+
+    // Records of the replayed tick and names of the devices of the last
+    // table, addressed by device index
+    uint64_t m_connected = 0;
+    std::array<PoseRecord, vr::k_unMaxTrackedDeviceCount> m_records = {};
+    std::array<DeviceName, vr::k_unMaxTrackedDeviceCount> m_names = {};
+
+    std::deque<vr::VREvent_t> m_pendingEvents;
+
+    mutable std::recursive_mutex m_mutex;
+};
+
+#endif // OPENVR_TRACKERS_REPLAY_BACKEND_H
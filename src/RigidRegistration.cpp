@@ -0,0 +1,248 @@
+/*
+ * Copyright (C) 2021 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include "RigidRegistration.h"
+#include "Rotations.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Smallest spread of the source points along any direction, relative to
+    // their total spread, below which they are considered collinear
+    constexpr double MinRelativeSpread = 1e-6;
+
+    // Eigen decomposition of a symmetric matrix with the cyclic Jacobi
+    // method. The eigenvectors are the columns of `vectors`.
+    template <size_t N>
+    void SymmetricEigen(std::array<double, N * N> A,
+                        std::array<double, N>& values,
+                        std::array<double, N * N>& vectors)
+    {
+        vectors = {};
+        for (size_t i = 0; i < N; ++i) {
+            vectors[N * i + i] = 1;
+        }
+
+        for (size_t sweep = 0; sweep < 50; ++sweep) {
+            double diagonal = 0;
+            double offDiagonal = 0;
+            for (size_t p = 0; p < N; ++p) {
+                diagonal += A[N * p + p] * A[N * p + p];
+                for (size_t q = p + 1; q < N; ++q) {
+                    offDiagonal += A[N * p + q] * A[N * p + q];
+                }
+            }
+
+            if (offDiagonal <= 1e-30 * diagonal) {
+                break;
+            }
+
+            for (size_t p = 0; p < N; ++p) {
+                for (size_t q = p + 1; q < N; ++q) {
+                    if (A[N * p + q] == 0) {
+                        continue;
+                    }
+
+                    // Rotation in the (p, q) plane zeroing A(p, q)
+                    const double theta =
+                        (A[N * q + q] - A[N * p + p]) / (2 * A[N * p + q]);
+                    const double t =
+                        std::copysign(1.0, theta)
+                        / (std::abs(theta) + std::sqrt(theta * theta + 1));
+                    const double c = 1 / std::sqrt(t * t + 1);
+                    const double s = t * c;
+
+                    for (size_t k = 0; k < N; ++k) {
+                        const double kp = A[N * k + p];
+                        const double kq = A[N * k + q];
+                        A[N * k + p] = c * kp - s * kq;
+                        A[N * k + q] = s * kp + c * kq;
+                    }
+
+                    for (size_t k = 0; k < N; ++k) {
+                        const double pk = A[N * p + k];
+                        const double qk = A[N * q + k];
+                        A[N * p + k] = c * pk - s * qk;
+                        A[N * q + k] = s * pk + c * qk;
+                    }
+
+                    for (size_t k = 0; k < N; ++k) {
+                        const double kp = vectors[N * k + p];
+                        const double kq = vectors[N * k + q];
+                        vectors[N * k + p] = c * kp - s * kq;
+                        vectors[N * k + q] = s * kp + c * kq;
+                    }
+                }
+            }
+        }
+
+        for (size_t i = 0; i < N; ++i) {
+            values[i] = A[N * i + i];
+        }
+    }
+} // namespace
+
+void openvr::RigidRegistration::reset()
+{
+    *this = {};
+}
+
+void openvr::RigidRegistration::addPair(const std::array<double, 3>& source,
+                                        const std::array<double, 3>& target)
+{
+    m_size++;
+
+    std::array<double, 3> sourceDelta;
+    std::array<double, 3> targetDelta;
+    for (size_t i = 0; i < 3; ++i) {
+        sourceDelta[i] = source[i] - m_sourceMean[i];
+        targetDelta[i] = target[i] - m_targetMean[i];
+        m_sourceMean[i] += sourceDelta[i] / double(m_size);
+        m_targetMean[i] += targetDelta[i] / double(m_size);
+    }
+
+    // The products use the deviations from the old and the new means
+    for (size_t a = 0; a < 3; ++a) {
+        for (size_t b = 0; b < 3; ++b) {
+            m_crossCovariance[3 * a + b] +=
+                sourceDelta[a] * (target[b] - m_targetMean[b]);
+            m_sourceScatter[3 * a + b] +=
+                sourceDelta[a] * (source[b] - m_sourceMean[b]);
+        }
+
+        m_targetVariance += targetDelta[a] * (target[a] - m_targetMean[a]);
+    }
+}
+
+size_t openvr::RigidRegistration::size() const
+{
+    return m_size;
+}
+
+std::optional<openvr::Transform> openvr::RigidRegistration::solve() const
+{
+    std::array<double, 4> quaternion;
+    return this->solve(quaternion);
+}
+
+std::optional<openvr::Transform>
+openvr::RigidRegistration::solve(std::array<double, 4>& quaternion) const
+{
+    if (m_size < 3) {
+        return std::nullopt;
+    }
+
+    // The source points must span a plane
+    std::array<double, 3> spread;
+    std::array<double, 9> directions;
+    SymmetricEigen<3>(m_sourceScatter, spread, directions);
+    std::sort(spread.begin(), spread.end());
+
+    const double totalSpread = spread[0] + spread[1] + spread[2];
+    if (!(spread[1] > MinRelativeSpread * totalSpread)) {
+        return std::nullopt;
+    }
+
+    // Matrix of Horn, whose eigenvector with the largest eigenvalue is the
+    // quaternion (w, x, y, z) rotating the source points onto the targets
+    const auto S = [&](const size_t a, const size_t b) {
+        return m_crossCovariance[3 * a + b];
+    };
+
+    const std::array<double, 16> N = {
+        S(0, 0) + S(1, 1) + S(2, 2),
+        S(1, 2) - S(2, 1),
+        S(2, 0) - S(0, 2),
+        S(0, 1) - S(1, 0),
+        //
+        S(1, 2) - S(2, 1),
+        S(0, 0) - S(1, 1) - S(2, 2),
+        S(0, 1) + S(1, 0),
+        S(2, 0) + S(0, 2),
+        //
+        S(2, 0) - S(0, 2),
+        S(0, 1) + S(1, 0),
+        -S(0, 0) + S(1, 1) - S(2, 2),
+        S(1, 2) + S(2, 1),
+        //
+        S(0, 1) - S(1, 0),
+        S(2, 0) + S(0, 2),
+        S(1, 2) + S(2, 1),
+        -S(0, 0) - S(1, 1) + S(2, 2),
+    };
+
+    std::array<double, 4> values;
+    std::array<double, 16> vectors;
+    SymmetricEigen<4>(N, values, vectors);
+
+    const size_t largest = size_t(
+        std::max_element(values.begin(), values.end()) - values.begin());
+    const double norm = std::sqrt(
+        vectors[largest] * vectors[largest]
+        + vectors[4 + largest] * vectors[4 + largest]
+        + vectors[8 + largest] * vectors[8 + largest]
+        + vectors[12 + largest] * vectors[12 + largest]);
+    const double scale = std::copysign(1 / norm, vectors[largest]);
+
+    for (size_t i = 0; i < 4; ++i) {
+        quaternion[i] = vectors[4 * i + largest] * scale;
+    }
+
+    Transform transform;
+    QuaternionToRotation(quaternion.data(), transform.rotationRowMajor.data());
+
+    // The translation maps the mean of the sources onto the mean of the
+    // targets
+    const auto& R = transform.rotationRowMajor;
+    for (size_t i = 0; i < 3; ++i) {
+        transform.position[i] = m_targetMean[i]
+                                - (R[3 * i] * m_sourceMean[0]
+                                   + R[3 * i + 1] * m_sourceMean[1]
+                                   + R[3 * i + 2] * m_sourceMean[2]);
+    }
+
+    return transform;
+}
+
+double openvr::RigidRegistration::rms(const Transform& transform) const
+{
+    if (m_size == 0) {
+        return 0;
+    }
+
+    const auto& R = transform.rotationRowMajor;
+
+    // Sum of the squared residuals of the centered points, expanded as
+    // |R s|^2 + |q|^2 - 2 q' R s
+    double correlation = 0;
+    for (size_t a = 0; a < 3; ++a) {
+        for (size_t b = 0; b < 3; ++b) {
+            correlation += R[3 * b + a] * m_crossCovariance[3 * a + b];
+        }
+    }
+
+    const double sourceVariance =
+        m_sourceScatter[0] + m_sourceScatter[4] + m_sourceScatter[8];
+    const double centered =
+        sourceVariance + m_targetVariance - 2 * correlation;
+
+    // Residual of the means
+    double offset = 0;
+    for (size_t i = 0; i < 3; ++i) {
+        const double residual = R[3 * i] * m_sourceMean[0]
+                                + R[3 * i + 1] * m_sourceMean[1]
+                                + R[3 * i + 2] * m_sourceMean[2]
+                                + transform.position[i] - m_targetMean[i];
+        offset += residual * residual;
+    }
+
+    return std::sqrt(std::max(0.0, centered / double(m_size) + offset));
+}
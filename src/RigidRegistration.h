@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2021 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef OPENVR_TRACKERS_RIGID_REGISTRATION_H
+#define OPENVR_TRACKERS_RIGID_REGISTRATION_H
+
+#include "OpenVRTrackersDriver.h"
+
+#include <array>
+#include <cstddef>
+#include <optional>
+
+namespace openvr {
+    class RigidRegistration;
+} // namespace openvr
+
+/**
+ * Least-squares rigid transform between two sets of corresponding points.
+ *
+ * The pairs are not stored: only their means and their cross-covariance are
+ * accumulated, so that any number of pairs can be added in constant memory
+ * and time per pair. The rotation is computed with the closed-form solution
+ * of Horn, as the eigenvector of the largest eigenvalue of a symmetric 4x4
+ * matrix, which always yields a proper rotation.
+ *
+ * The registration is not thread safe.
+ */
+class openvr::RigidRegistration
+{
+public:
+    void reset();
+
+    // Add a pair of corresponding points: `source` expressed in the frame to
+    // calibrate and `target` expressed in the reference frame
+    void addPair(const std::array<double, 3>& source,
+                 const std::array<double, 3>& target);
+    size_t size() const;
+
+    // Transform T minimizing the sum of |T * source - target|^2 over the
+    // pairs. Empty if the source points are fewer than 3 or collinear.
+    std::optional<Transform> solve() const;
+
+    // Same as solve(), also returning the quaternion (w, x, y, z) of the
+    // rotation with w >= 0. It is the eigenvector computed by the method,
+    // exact also for half turns, unlike the conversions of the matrix.
+    std::optional<Transform> solve(std::array<double, 4>& quaternion) const;
+
+    // Root mean square of |T * source - target| over the pairs [m]
+    double rms(const Transform& transform) const;
+
+private:
+    size_t m_size = 0;
+    std::array<double, 3> m_sourceMean = {};
+    std::array<double, 3> m_targetMean = {};
+
+    // Sums over the pairs of the products of the centered coordinates,
+    // updated with the algorithm of Welford
+    std::array<double, 9> m_crossCovariance = {};
+    std::array<double, 9> m_sourceScatter = {};
+    double m_targetVariance = 0;
+};
+
+#endif // OPENVR_TRACKERS_RIGID_REGISTRATION_H
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2021 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef OPENVR_TRACKERS_ROTATIONS_H
+#define OPENVR_TRACKERS_ROTATIONS_H
+
+#include <algorithm>
+#include <cmath>
+
+// Conversions between row-major rotation matrices and unit quaternions in
+// (w, x, y, z) order
+namespace openvr {
+
+    // Branch-free conversion, so that converting the poses of all the
+    // devices is a single loop without unpredictable branches. The
+    // magnitudes of the components are computed from the diagonal and their
+    // signs from the off-diagonal terms, with w >= 0.
+    //
+    // Near 180 degrees, i.e. when the trace approaches -1, the off-diagonal
+    // differences giving the signs vanish and are dominated by the rounding
+    // errors, so the relative signs of x, y and z are lost. For instance, the
+    // half turn about (0, 1, -1) / sqrt(2) gives (0, 0, 0.707, 0.707). Use
+    // RotationToQuaternionExact() outside the per-tick loops, and for the
+    // rotations for which CloseToHalfTurn() is true.
+    inline void RotationToQuaternion(const double* R, double* q)
+    {
+        const double w = std::sqrt(std::max(0.0, 1 + R[0] + R[4] + R[8]));
+        const double x = std::sqrt(std::max(0.0, 1 + R[0] - R[4] - R[8]));
+        const double y = std::sqrt(std::max(0.0, 1 - R[0] + R[4] - R[8]));
+        const double z = std::sqrt(std::max(0.0, 1 - R[0] - R[4] + R[8]));
+
+        // The components are twice their value, the normalization also
+        // compensates the non-orthogonality of single precision matrices
+        const double norm = std::sqrt(w * w + x * x + y * y + z * z);
+        const double scale = 1 / std::max(norm, 1e-12);
+
+        q[0] = w * scale;
+        q[1] = std::copysign(x * scale, R[7] - R[5]);
+        q[2] = std::copysign(y * scale, R[2] - R[6]);
+        q[3] = std::copysign(z * scale, R[3] - R[1]);
+    }
+
+    // Rotations for which RotationToQuaternion() could return wrong signs,
+    // those within 0.1 rad from 180 degrees
+    inline bool CloseToHalfTurn(const double* R)
+    {
+        return R[0] + R[4] + R[8] < -0.99;
+    }
+
+    // Conversion of Shepperd, accurate for all the rotations. The largest
+    // component is computed from the diagonal, and the others from the
+    // off-diagonal terms divided by it. The quaternion has w >= 0.
+    inline void RotationToQuaternionExact(const double* R, double* q)
+    {
+        const double trace = R[0] + R[4] + R[8];
+        double w, x, y, z;
+
+        if (trace >= R[0] && trace >= R[4] && trace >= R[8]) {
+            const double s = 2 * std::sqrt(1 + trace);
+            w = s / 4;
+            x = (R[7] - R[5]) / s;
+            y = (R[2] - R[6]) / s;
+            z = (R[3] - R[1]) / s;
+        }
+        else if (R[0] >= R[4] && R[0] >= R[8]) {
+            const double s = 2 * std::sqrt(1 + R[0] - R[4] - R[8]);
+            w = (R[7] - R[5]) / s;
+            x = s / 4;
+            y = (R[1] + R[3]) / s;
+            z = (R[2] + R[6]) / s;
+        }
+        else if (R[4] >= R[8]) {
+            const double s = 2 * std::sqrt(1 - R[0] + R[4] - R[8]);
+            w = (R[2] - R[6]) / s;
+            x = (R[1] + R[3]) / s;
+            y = s / 4;
+            z = (R[5] + R[7]) / s;
+        }
+        else {
+            const double s = 2 * std::sqrt(1 - R[0] - R[4] + R[8]);
+            w = (R[3] - R[1]) / s;
+            x = (R[2] + R[6]) / s;
+            y = (R[5] + R[7]) / s;
+            z = s / 4;
+        }
+
+        // The normalization compensates the non-orthogonality of single
+        // precision matrices
+        const double norm = std::sqrt(w * w + x * x + y * y + z * z);
+        const double scale = std::copysign(1 / std::max(norm, 1e-12), w);
+
+        q[0] = w * scale;
+        q[1] = x * scale;
+        q[2] = y * scale;
+        q[3] = z * scale;
+    }
+
+    // The quaternion is normalized
+    inline void QuaternionToRotation(const double* q, double* R)
+    {
+        const double norm =
+            std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+        const double scale = 1 / std::max(norm, 1e-12);
+
+        const double w = q[0] * scale;
+        const double x = q[1] * scale;
+        const double y = q[2] * scale;
+        const double z = q[3] * scale;
+
+        R[0] = 1 - 2 * (y * y + z * z);
+        R[1] = 2 * (x * y - w * z);
+        R[2] = 2 * (x * z + w * y);
+        R[3] = 2 * (x * y + w * z);
+        R[4] = 1 - 2 * (x * x + z * z);
+        R[5] = 2 * (y * z - w * x);
+        R[6] = 2 * (x * z - w * y);
+        R[7] = 2 * (y * z + w * x);
+        R[8] = 1 - 2 * (x * x + y * y);
+    }
+} // namespace openvr
+
+#endif // OPENVR_TRACKERS_ROTATIONS_H
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2021 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef OPENVR_TRACKERS_SEQLOCK_H
+#define OPENVR_TRACKERS_SEQLOCK_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+namespace openvr {
+    template <typename T>
+    class SeqLock;
+} // namespace openvr
+
+/**
+ * Single-writer / multi-reader sequence lock.
+ *
+ * The writer never waits. Readers never take locks: they copy the value and
+ * retry if the writer modified it in the meantime. The value must be
+ * trivially copyable, since readers could observe it partially written.
+ */
+template <typename T>
+class openvr::SeqLock
+{
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "SeqLock requires a trivially copyable type");
+
+public:
+    SeqLock() = default;
+    SeqLock(const SeqLock&) = delete;
+    SeqLock& operator=(const SeqLock&) = delete;
+
+    // Must be called by a single thread at a time
+    void store(const T& value)
+    {
+        const uint64_t sequence = m_sequence.load(std::memory_order_relaxed);
+
+        // An odd sequence marks a write in progress
+        m_sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        std::memcpy(&m_value, &value, sizeof(T));
+
+        m_sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    // Returns the number of stores that produced the copied value
+    uint64_t load(T& value) const
+    {
+        while (true) {
+            const uint64_t before = m_sequence.load(std::memory_order_acquire);
+
+            if (before & 1) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            std::memcpy(&value, &m_value, sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if (m_sequence.load(std::memory_order_relaxed) == before) {
+                return before / 2;
+            }
+        }
+    }
+
+    uint64_t version() const
+    {
+        return m_sequence.load(std::memory_order_acquire) / 2;
+    }
+
+private:
+    std::atomic<uint64_t> m_sequence{0};
+    T m_value = {};
+};
+
+#endif // OPENVR_TRACKERS_SEQLOCK_H
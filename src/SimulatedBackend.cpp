@@ -0,0 +1,420 @@
+/*
+ * Copyright (C) 2021 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include "SimulatedBackend.h"
+
+#include <yarp/os/LogStream.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    constexpr double Pi = 3.14159265358979323846;
+
+    vr::TrackedDevicePose_t InvalidPose()
+    {
+        vr::TrackedDevicePose_t pose = {};
+        pose.eTrackingResult = vr::TrackingResult_Uninitialized;
+        pose.bPoseIsValid = false;
+        pose.bDeviceIsConnected = false;
+        return pose;
+    }
+} // namespace
+
+openvr::SimulatedBackend::SimulatedBackend()
+    : SimulatedBackend(Options())
+{}
+
+openvr::SimulatedBackend::SimulatedBackend(Options options)
+    : m_options(std::move(options))
+{
+    if (!m_options.trajectory) {
+        m_options.trajectory = &SimulatedBackend::CircularTrajectory;
+    }
+
+    // Scripted events are consumed in chronological order
+    std::stable_sort(m_options.events.begin(),
+                     m_options.events.end(),
+                     [](const ScriptedEvent& a, const ScriptedEvent& b) {
+                         return a.time < b.time;
+                     });
+
+    // Allocate the devices to consecutive indices
+    const auto allocate = [&](const size_t number,
+                              const vr::ETrackedDeviceClass type,
+                              const std::string& prefix) {
+        for (size_t i = 0; i < number; ++i) {
+            Device device;
+            device.type = type;
+            device.serialNumber = prefix + std::to_string(i);
+            device.connected = true;
+            m_devices.push_back(device);
+        }
+    };
+
+    allocate(m_options.hmds, vr::TrackedDeviceClass_HMD, "SIM-HMD-");
+    allocate(m_options.trackingReferences,
+             vr::TrackedDeviceClass_TrackingReference,
+             "SIM-REF-");
+    allocate(m_options.controllers,
+             vr::TrackedDeviceClass_Controller,
+             "SIM-CTRL-");
+    allocate(m_options.genericTrackers,
+             vr::TrackedDeviceClass_GenericTracker,
+             "SIM-TRK-");
+
+    // Assign the roles following the naming of the Vive trackers
+    size_t controllers = 0;
+    size_t trackers = 0;
+    for (Device& device : m_devices) {
+        if (device.type == vr::TrackedDeviceClass_Controller) {
+            device.controllerType = "simulated_controller";
+            device.wireless = true;
+            device.role = controllers++ % 2 == 0
+                              ? vr::TrackedControllerRole_LeftHand
+                              : vr::TrackedControllerRole_RightHand;
+        }
+        else if (device.type == vr::TrackedDeviceClass_GenericTracker) {
+            device.controllerType = "vive_tracker";
+            device.wireless = true;
+            if (trackers < m_options.trackerRoles.size()) {
+                device.controllerType += "_" + m_options.trackerRoles[trackers];
+            }
+            trackers++;
+        }
+    }
+
+    for (const auto index : m_options.initiallyDisconnected) {
+        if (index < m_devices.size()) {
+            m_devices[index].connected = false;
+        }
+    }
+}
+
+vr::TrackedDevicePose_t
+openvr::SimulatedBackend::CircularTrajectory(const vr::TrackedDeviceIndex_t index,
+                                             const double time)
+{
+    // Each device moves on a horizontal circle around its own center,
+    // rotating about the vertical axis (y-up, as in OpenVR)
+    constexpr double Radius = 0.2;
+    constexpr double Omega = 2 * Pi * 0.25;
+
+    const double angle = Omega * time + 0.5 * index;
+    const double c = std::cos(angle);
+    const double s = std::sin(angle);
+
+    const double center[3] = {
+        0.5 * (index % 8) - 1.75,
+        1.0,
+        0.5 * (index / 8) - 2.0,
+    };
+
+    vr::TrackedDevicePose_t pose = {};
+    auto& m = pose.mDeviceToAbsoluteTracking.m;
+
+    m[0][0] = float(c);
+    m[0][1] = 0;
+    m[0][2] = float(s);
+    m[1][0] = 0;
+    m[1][1] = 1;
+    m[1][2] = 0;
+    m[2][0] = float(-s);
+    m[2][1] = 0;
+    m[2][2] = float(c);
+
+    m[0][3] = float(center[0] + Radius * c);
+    m[1][3] = float(center[1]);
+    m[2][3] = float(center[2] + Radius * s);
+
+    pose.vVelocity.v[0] = float(-Radius * Omega * s);
+    pose.vVelocity.v[1] = 0;
+    pose.vVelocity.v[2] = float(Radius * Omega * c);
+
+    pose.vAngularVelocity.v[0] = 0;
+    pose.vAngularVelocity.v[1] = float(Omega);
+    pose.vAngularVelocity.v[2] = 0;
+
+    pose.eTrackingResult = vr::TrackingResult_Running_OK;
+    pose.bPoseIsValid = true;
+    pose.bDeviceIsConnected = true;
+
+    return pose;
+}
+
+size_t openvr::SimulatedBackend::deviceCount() const
+{
+    const auto lock = std::unique_lock(m_mutex);
+    return m_devices.size();
+}
+
+double openvr::SimulatedBackend::time() const
+{
+    const auto lock = std::unique_lock(m_mutex);
+    return this->currentTime();
+}
+
+void openvr::SimulatedBackend::advance(const double seconds)
+{
+    const auto lock = std::unique_lock(m_mutex);
+    m_steppedTime += seconds;
+    this->dispatchScriptedEvents();
+}
+
+bool openvr::SimulatedBackend::initialize()
+{
+    const auto lock = std::unique_lock(m_mutex);
+
+    if (m_running) {
+        yError() << "Simulated runtime already initialized";
+        return false;
+    }
+
+    if (m_devices.size() > vr::k_unMaxTrackedDeviceCount) {
+        yError() << "Cannot simulate" << m_devices.size()
+                 << "devices, the maximum is" << vr::k_unMaxTrackedDeviceCount;
+        return false;
+    }
+
+    m_running = true;
+    m_steppedTime = 0;
+    m_startTime = std::chrono::steady_clock::now();
+    m_nextScriptedEvent = 0;
+    m_pendingEvents.clear();
+
+    yDebug() << "Simulated runtime started with" << m_devices.size()
+             << "devices";
+    return true;
+}
+
+void openvr::SimulatedBackend::shutdown()
+{
+    const auto lock = std::unique_lock(m_mutex);
+    m_running = false;
+}
+
+bool openvr::SimulatedBackend::running() const
+{
+    const auto lock = std::unique_lock(m_mutex);
+    return m_running;
+}
+
+bool openvr::SimulatedBackend::isTrackedDeviceConnected(
+    const vr::TrackedDeviceIndex_t index) const
+{
+    const auto lock = std::unique_lock(m_mutex);
+    return index < m_devices.size() && m_devices[index].connected;
+}
+
+vr::ETrackedDeviceClass openvr::SimulatedBackend::trackedDeviceClass(
+    const vr::TrackedDeviceIndex_t index) const
+{
+    const auto lock = std::unique_lock(m_mutex);
+
+    if (index >= m_devices.size() || !m_devices[index].connected) {
+        return vr::TrackedDeviceClass_Invalid;
+    }
+
+    return m_devices[index].type;
+}
+
+std::string openvr::SimulatedBackend::stringProperty(
+    const vr::TrackedDeviceIndex_t index,
+    const vr::ETrackedDeviceProperty property) const
+{
+    const auto lock = std::unique_lock(m_mutex);
+
+    if (index >= m_devices.size()) {
+        return {};
+    }
+
+    switch (property) {
+        case vr::Prop_SerialNumber_String:
+            return m_devices[index].serialNumber;
+        case vr::Prop_ModelNumber_String:
+            return "Simulated";
+        case vr::Prop_TrackingFirmwareVersion_String:
+            return "simulated";
+        case vr::Prop_ControllerType_String:
+            return m_devices[index].controllerType;
+        default:
+            return {};
+    }
+}
+
+int32_t openvr::SimulatedBackend::int32Property(
+    const vr::TrackedDeviceIndex_t index,
+    const vr::ETrackedDeviceProperty property) const
+{
+    const auto lock = std::unique_lock(m_mutex);
+
+    if (index >= m_devices.size()) {
+        return 0;
+    }
+
+    switch (property) {
+        case vr::Prop_ControllerRoleHint_Int32:
+            return m_devices[index].role;
+        default:
+            return 0;
+    }
+}
+
+float openvr::SimulatedBackend::floatProperty(
+    const vr::TrackedDeviceIndex_t index,
+    const vr::ETrackedDeviceProperty property) const
+{
+    const auto lock = std::unique_lock(m_mutex);
+
+    if (index >= m_devices.size()) {
+        return 0;
+    }
+
+    // Simulated batteries are always charged
+    switch (property) {
+        case vr::Prop_DeviceBatteryPercentage_Float:
+            return m_devices[index].wireless ? 1.0f : 0.0f;
+        default:
+            return 0;
+    }
+}
+
+bool openvr::SimulatedBackend::boolProperty(
+    const vr::TrackedDeviceIndex_t index,
+    const vr::ETrackedDeviceProperty property) const
+{
+    const auto lock = std::unique_lock(m_mutex);
+
+    if (index >= m_devices.size()) {
+        return false;
+    }
+
+    switch (property) {
+        case vr::Prop_DeviceIsWireless_Bool:
+            return m_devices[index].wireless;
+        default:
+            return false;
+    }
+}
+
+void openvr::SimulatedBackend::deviceToAbsoluteTrackingPose(
+    const vr::ETrackingUniverseOrigin /*origin*/,
+    const float predictedSecondsToPhotonsFromNow,
+    vr::TrackedDevicePose_t* poses,
+    const uint32_t count)
+{
+    const auto lock = std::unique_lock(m_mutex);
+
+    // The simulated universe is the same for all the origins
+    const double sampleTime =
+        this->currentTime() + predictedSecondsToPhotonsFromNow;
+
+    for (uint32_t index = 0; index < count; ++index) {
+        if (index < m_devices.size() && m_devices[index].connected) {
+            poses[index] = m_options.trajectory(index, sampleTime);
+        }
+        else {
+            poses[index] = InvalidPose();
+        }
+    }
+
+    if (m_options.clock == Clock::Stepped) {
+        m_steppedTime += m_options.timeStep;
+    }
+
+    this->dispatchScriptedEvents();
+}
+
+bool openvr::SimulatedBackend::timeSinceLastVsync(float& seconds,
+                                                  uint64_t& frameCounter) const
+{
+    const auto lock = std::unique_lock(m_mutex);
+
+    if (!(m_options.displayFrequency > 0)) {
+        return false;
+    }
+
+    // The simulated display refreshes since the start of the runtime
+    const double frames = this->currentTime() * m_options.displayFrequency;
+    frameCounter = uint64_t(frames);
+    seconds = float((frames - std::floor(frames)) / m_options.displayFrequency);
+    return true;
+}
+
+bool openvr::SimulatedBackend::pollNextEvent(vr::VREvent_t& event)
+{
+    const auto lock = std::unique_lock(m_mutex);
+
+    this->dispatchScriptedEvents();
+
+    if (m_pendingEvents.empty()) {
+        return false;
+    }
+
+    event = m_pendingEvents.front();
+    m_pendingEvents.pop_front();
+    return true;
+}
+
+void openvr::SimulatedBackend::acknowledgeQuit() {}
+
+void openvr::SimulatedBackend::resetZeroPose(
+    const vr::ETrackingUniverseOrigin /*origin*/)
+{}
+
+double openvr::SimulatedBackend::currentTime() const
+{
+    switch (m_options.clock) {
+        case Clock::WallClock:
+            return std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - m_startTime)
+                .count();
+        case Clock::Stepped:
+        default:
+            return m_steppedTime;
+    }
+}
+
+void openvr::SimulatedBackend::dispatchScriptedEvents()
+{
+    if (!m_running) {
+        return;
+    }
+
+    const double now = this->currentTime();
+
+    while (m_nextScriptedEvent < m_options.events.size()
+           && m_options.events[m_nextScriptedEvent].time <= now) {
+
+        const auto& scripted = m_options.events[m_nextScriptedEvent++];
+
+        // Apply the effect of the event to the simulated devices
+        switch (scripted.type) {
+            case vr::VREvent_TrackedDeviceActivated:
+            case vr::VREvent_TrackedDeviceDeactivated:
+                if (scripted.index >= m_devices.size()) {
+                    yWarning() << "Ignoring scripted event for unknown device"
+                               << scripted.index;
+                    continue;
+                }
+                m_devices[scripted.index].connected =
+                    scripted.type == vr::VREvent_TrackedDeviceActivated;
+                break;
+            default:
+                break;
+        }
+
+        vr::VREvent_t event = {};
+        event.eventType = scripted.type;
+        event.trackedDeviceIndex = scripted.index;
+        event.eventAgeSeconds = float(now - scripted.time);
+        m_pendingEvents.push_back(event);
+    }
+}
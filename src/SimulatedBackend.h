@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2021 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef OPENVR_TRACKERS_SIMULATED_BACKEND_H
+#define OPENVR_TRACKERS_SIMULATED_BACKEND_H
+
+#include "TrackingBackend.h"
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace openvr {
+    class SimulatedBackend;
+} // namespace openvr
+
+/**
+ * Deterministic tracking backend that does not require SteamVR.
+ *
+ * Devices are allocated to consecutive indices in the following order:
+ * HMDs, tracking references (base stations), controllers and generic
+ * trackers. Tracking references are not supported by the manager and can be
+ * used to create sparse device indices.
+ *
+ * The simulated time either follows the wall clock, or it is advanced by a
+ * fixed step every time poses are read. Scripted events are delivered by
+ * pollNextEvent() as soon as the simulated time reaches their timestamp.
+ */
+class openvr::SimulatedBackend final : public openvr::TrackingBackend
+{
+public:
+    /**
+     * Compute the pose of a device at a given simulated time.
+     */
+    using Trajectory = std::function<vr::TrackedDevicePose_t(
+        const vr::TrackedDeviceIndex_t index,
+        const double time)>;
+
+    struct ScriptedEvent
+    {
+        double time = 0;
+        vr::EVREventType type = vr::VREvent_None;
+        vr::TrackedDeviceIndex_t index = vr::k_unTrackedDeviceIndex_Hmd;
+    };
+
+    enum class Clock
+    {
+        WallClock,
+        Stepped,
+    };
+
+    struct Options
+    {
+        size_t hmds = 1;
+        size_t trackingReferences = 0;
+        size_t controllers = 2;
+        size_t genericTrackers = 3;
+
+        Clock clock = Clock::Stepped;
+        double timeStep = 0.010;
+        double displayFrequency = 90;
+
+        // Roles of the first generic trackers (e.g. "left_foot"), reported
+        // through their controller type. Controllers alternate between the
+        // left and right hand roles.
+        std::vector<std::string> trackerRoles;
+
+        std::vector<vr::TrackedDeviceIndex_t> initiallyDisconnected;
+        std::vector<ScriptedEvent> events;
+
+        // Defaults to SimulatedBackend::CircularTrajectory
+        Trajectory trajectory;
+    };
+
+    SimulatedBackend();
+    explicit SimulatedBackend(Options options);
+    ~SimulatedBackend() override = default;
+
+    static vr::TrackedDevicePose_t
+    CircularTrajectory(const vr::TrackedDeviceIndex_t index, const double time);
+
+    size_t deviceCount() const;
+    double time() const;
+    void advance(const double seconds);
+
+    bool initialize() override;
+    void shutdown() override;
+    bool running() const override;
+
+    bool isTrackedDeviceConnected(
+        const vr::TrackedDeviceIndex_t index) const override;
+    vr::ETrackedDeviceClass
+    trackedDeviceClass(const vr::TrackedDeviceIndex_t index) const override;
+    std::string
+    stringProperty(const vr::TrackedDeviceIndex_t index,
+                   const vr::ETrackedDeviceProperty property) const override;
+    int32_t
+    int32Property(const vr::TrackedDeviceIndex_t index,
+                  const vr::ETrackedDeviceProperty property) const override;
+    float
+    floatProperty(const vr::TrackedDeviceIndex_t index,
+                  const vr::ETrackedDeviceProperty property) const override;
+    bool
+    boolProperty(const vr::TrackedDeviceIndex_t index,
+                 const vr::ETrackedDeviceProperty property) const override;
+
+    void
+    deviceToAbsoluteTrackingPose(const vr::ETrackingUniverseOrigin origin,
+                                 const float predictedSecondsToPhotonsFromNow,
+                                 vr::TrackedDevicePose_t* poses,
+                                 const uint32_t count) override;
+
+    bool timeSinceLastVsync(float& seconds,
+                            uint64_t& frameCounter) const override;
+
+    bool pollNextEvent(vr::VREvent_t& event) override;
+    void acknowledgeQuit() override;
+
+    void resetZeroPose(const vr::ETrackingUniverseOrigin origin) override;
+
+private:
+    struct Device
+    {
+        vr::ETrackedDeviceClass type = vr::TrackedDeviceClass_Invalid;
+        std::string serialNumber;
+        std::string controllerType;
+        vr::ETrackedControllerRole role = vr::TrackedControllerRole_Invalid;
+        bool wireless = false;
+        bool connected = false;
+    };
+
+    double currentTime() const;
+    void dispatchScriptedEvents();
+
+    Options m_options;
+    std::vector<Device> m_devices;
+
+    bool m_running = false;
+    double m_steppedTime = 0;
+    std::chrono::steady_clock::time_point m_startTime;
+
+    size_t m_nextScriptedEvent = 0;
+    std::deque<vr::VREvent_t> m_pendingEvents;
+
+    mutable std::recursive_mutex m_mutex;
+};
+
+#endif // OPENVR_TRACKERS_SIMULATED_BACKEND_H
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2021 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#ifndef OPENVR_TRACKERS_TRACKING_BACKEND_H
+#define OPENVR_TRACKERS_TRACKING_BACKEND_H
+
+#include <openvr.h>
+
+#include <cstdint>
+#include <string>
+
+namespace openvr {
+    class TrackingBackend;
+} // namespace openvr
+
+/**
+ * Source of tracking data used by the DevicesManager.
+ *
+ * The interface mirrors the subset of vr::IVRSystem used by the manager, so
+ * that the real OpenVR runtime can be replaced e.g. by a simulated one.
+ * Methods are only called between a successful initialize() and shutdown().
+ */
+class openvr::TrackingBackend
+{
+public:
+    virtual ~TrackingBackend() = default;
+
+    virtual bool initialize() = 0;
+    virtual void shutdown() = 0;
+    virtual bool running() const = 0;
+
+    virtual bool
+    isTrackedDeviceConnected(const vr::TrackedDeviceIndex_t index) const = 0;
+    virtual vr::ETrackedDeviceClass
+    trackedDeviceClass(const vr::TrackedDeviceIndex_t index) const = 0;
+    virtual std::string
+    stringProperty(const vr::TrackedDeviceIndex_t index,
+                   const vr::ETrackedDeviceProperty property) const = 0;
+    virtual int32_t
+    int32Property(const vr::TrackedDeviceIndex_t index,
+                  const vr::ETrackedDeviceProperty property) const = 0;
+    virtual float
+    floatProperty(const vr::TrackedDeviceIndex_t index,
+                  const vr::ETrackedDeviceProperty property) const = 0;
+    virtual bool
+    boolProperty(const vr::TrackedDeviceIndex_t index,
+                 const vr::ETrackedDeviceProperty property) const = 0;
+
+    virtual void
+    deviceToAbsoluteTrackingPose(const vr::ETrackingUniverseOrigin origin,
+                                 const float predictedSecondsToPhotonsFromNow,
+                                 vr::TrackedDevicePose_t* poses,
+                                 const uint32_t count) = 0;
+
+    virtual bool timeSinceLastVsync(float& seconds,
+                                    uint64_t& frameCounter) const = 0;
+
+    virtual bool pollNextEvent(vr::VREvent_t& event) = 0;
+    virtual void acknowledgeQuit() = 0;
+
+    virtual void resetZeroPose(const vr::ETrackingUniverseOrigin origin) = 0;
+};
+
+#endif // OPENVR_TRACKERS_TRACKING_BACKEND_H
@@ -9,17 +9,27 @@
  */
 
 #include "OpenVRTrackersDriver.h"
+#include "OpenVRBackend.h"
+#include "SimulatedBackend.h"
 
 #include <algorithm>
 #include <chrono>
 #include <iostream>
+#include <memory>
+#include <string>
 #include <thread>
 
-int main(int /*argc*/, char** /*argv*/)
+int main(int argc, char** argv)
 {
+    // Passing --simulated uses the simulated backend instead of SteamVR
+    const bool simulated = argc > 1 && std::string(argv[1]) == "--simulated";
+
     // Open
     std::cout << "[main] Opening the manager..." << std::endl;
-    auto manager = openvr::DevicesManager();
+    auto backend = simulated ? std::unique_ptr<openvr::TrackingBackend>(
+                       std::make_unique<openvr::SimulatedBackend>())
+                             : std::make_unique<openvr::OpenVRBackend>();
+    auto manager = openvr::DevicesManager(std::move(backend));
     std::cout << "[main] ... done" << std::endl;
 
     // Initialize
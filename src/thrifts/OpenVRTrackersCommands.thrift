@@ -6,6 +6,82 @@
  * BSD-2-Clause license. See the accompanying LICENSE file for details.
  */
 
+/**
+ * Statistics of a latency measure, expressed in seconds.
+ */
+struct LatencyStatistics
+{
+    /** Number of recorded samples. */
+    1: i64 count;
+    /** Median, with a relative error lower than 12.5%. */
+    2: double p50;
+    /** 99th percentile, with a relative error lower than 12.5%. */
+    3: double p99;
+    /** Maximum. */
+    4: double max;
+}
+
+/**
+ * Transform from the OpenVR tracking universe to a reference frame.
+ */
+struct CalibrationResult
+{
+    /** True if the transform is valid. */
+    1: bool valid;
+    /** Number of pairs of positions used to compute the transform. */
+    2: i64 samples;
+    /** Root mean square distance between the calibrated positions of the
+     *  tracker and the reference positions, in meters. */
+    3: double rms;
+    /** Position (x y z) in meters and quaternion (w x y z) of the
+     *  transform. */
+    4: list<double> transform;
+}
+
+/**
+ * State of a device published by the module.
+ */
+struct DeviceInfo
+{
+    /** Serial number of the device. */
+    1: string serialNumber;
+    /** Name of the frame of the published transform. */
+    2: string frameName;
+    /** Type of the device: "hmd", "controllers" or "trackers". */
+    3: string type;
+    /** Role of the device, empty if it has none. */
+    4: string role;
+    /** Index of the device in the OpenVR runtime. */
+    5: i64 index;
+    /** True if the last computed pose is valid. */
+    6: bool valid;
+    /** Tracking result of the last computed pose: "uninitialized",
+     *  "calibrating", "calibratingOutOfRange", "ok", "outOfRange" or
+     *  "rotationOnly". */
+    7: string trackingResult;
+    /** Time elapsed since the last valid pose of the device was acquired,
+     *  in seconds, or -1 if it has never been tracked. */
+    8: double age;
+}
+
+/**
+ * Settings of the module that can be changed at runtime.
+ */
+struct RuntimeSettings
+{
+    /** Period of the module, in seconds. */
+    1: double period;
+    /** Origin of the tracking universe: "seated", "standing" or "raw". */
+    2: string origin;
+    /** Prediction mode, see setPrediction. */
+    3: string predictionMode;
+    /** Prediction horizon, in seconds. */
+    4: double predictionHorizon;
+    /** Published outputs among "transforms", "poses", "state" and
+     *  "stats". */
+    5: list<string> outputs;
+}
+
 service OpenVRTrackersCommands
 {
     /**
@@ -13,4 +89,166 @@ service OpenVRTrackersCommands
      * @return true if the reset was successful.
      */
     bool resetSeatedPosition();
+
+    /**
+     * Sets the prediction applied to the published poses.
+     * @param mode "runtime" (OpenVR prediction from now), "vsync" (OpenVR
+     *        prediction from the last vsync), "velocity" or "acceleration"
+     *        (extrapolation with constant velocity or acceleration).
+     * @param horizon the prediction horizon in seconds, 0 to disable.
+     * @return true if the prediction was set. It is applied at the
+     *         beginning of the next cycle.
+     */
+    bool setPrediction(1: string mode, 2: double horizon);
+
+    /**
+     * Gets the prediction mode applied to the published poses.
+     * @return the prediction mode.
+     */
+    string getPredictionMode();
+
+    /**
+     * Gets the prediction horizon applied to the published poses.
+     * @return the prediction horizon in seconds.
+     */
+    double getPredictionHorizon();
+
+    /**
+     * Gets the names of the latency measures:
+     * "computePoses" (duration of the computation of the poses),
+     * "snapshot" (duration of the extraction of the poses),
+     * "publish" (duration of the publication of the poses),
+     * "age" (time elapsed from the computation to the publication of the
+     * poses) and "period" (time elapsed between consecutive cycles).
+     * @return the names of the measures.
+     */
+    list<string> getLatencyMeasures();
+
+    /**
+     * Gets the statistics of a latency measure.
+     * @param measure the name of the measure.
+     * @return the statistics, with zero count if the measure is unknown.
+     */
+    LatencyStatistics getLatencyStatistics(1: string measure);
+
+    /**
+     * Clears the samples of all the latency measures.
+     * @return true if the samples were cleared.
+     */
+    bool resetLatencyStatistics();
+
+    /**
+     * Starts recording the poses, before the filters, in a binary file
+     * (see src/PosesRecorder.h for the format).
+     * @param path the path of the file, which must not exist.
+     * @return true if the recording started.
+     */
+    bool startRecording(1: string path);
+
+    /**
+     * Stops recording the published poses.
+     * @return true if all the recorded poses were written to the file.
+     */
+    bool stopRecording();
+
+    /**
+     * Checks whether the published poses are being recorded.
+     * @return true if recording.
+     */
+    bool isRecording();
+
+    /**
+     * Moves the replayed recording to the given time, when using the replay
+     * backend.
+     * @param time the time from the start of the recording [s].
+     * @return true if the replay moved.
+     */
+    bool seekReplay(1: double time);
+
+    /**
+     * Starts collecting the positions of a tracker together with its
+     * reference positions, to compute the transform from the tracking
+     * universe to the reference frame. The samples of a previous
+     * calibration are discarded.
+     * @param serialNumber the serial number of the tracker.
+     * @param referenceFrame the frame whose position with respect to
+     *        calibrationWorldFrame is read from the stream of the
+     *        transformServer, or an empty string to read the positions from
+     *        the calibration port.
+     * @return true if the collection started.
+     */
+    bool startCalibration(1: string serialNumber, 2: string referenceFrame);
+
+    /**
+     * Gets the number of pairs of positions collected so far.
+     * @return the number of pairs.
+     */
+    i64 getCalibrationSamples();
+
+    /**
+     * Stops the collection, computes the transform, applies it to the
+     * published poses and saves it to the calibration file, if set.
+     * @return the computed calibration, not valid if the positions were
+     *         not enough or collinear.
+     */
+    CalibrationResult computeCalibration();
+
+    /**
+     * Gets the calibration applied to the published poses.
+     * @return the calibration, not valid if none is applied.
+     */
+    CalibrationResult getCalibration();
+
+    /**
+     * Stops the collection and removes the calibration applied to the
+     * published poses. The calibration file is not modified.
+     * @return true if the calibration was removed.
+     */
+    bool resetCalibration();
+
+    /**
+     * Gets the devices published by the module.
+     * @return the state of the devices.
+     */
+    list<DeviceInfo> getDevices();
+
+    /**
+     * Gets the settings of the module, including the ones set at runtime
+     * and not applied yet.
+     * @return the settings.
+     */
+    RuntimeSettings getSettings();
+
+    /**
+     * Sets all the settings of the module. The settings changed since the
+     * last cycle are applied together at the beginning of the next cycle.
+     * @param settings the new settings.
+     * @return true if the settings are valid, otherwise none is changed.
+     */
+    bool setSettings(1: RuntimeSettings settings);
+
+    /**
+     * Sets the period of the module, applied at the beginning of the next
+     * cycle.
+     * @param period the period in seconds.
+     * @return true if the period is valid.
+     */
+    bool setPublishPeriod(1: double period);
+
+    /**
+     * Sets the origin of the tracking universe of the published poses,
+     * applied at the beginning of the next cycle.
+     * @param origin "seated", "standing" or "raw".
+     * @return true if the origin is valid.
+     */
+    bool setOrigin(1: string origin);
+
+    /**
+     * Sets the published outputs, applied at the beginning of the next
+     * cycle. The ports of the outputs enabled for the first time are opened.
+     * @param outputs the outputs among "transforms", "poses", "state" and
+     *        "stats".
+     * @return true if the outputs are valid and their ports are open.
+     */
+    bool setOutputs(1: list<string> outputs);
 }
@@ -0,0 +1,441 @@
+/*
+ * Copyright (C) 2021 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include "OpenVRTrackersDriver.h"
+#include "SimulatedBackend.h"
+#include "TrackingBackend.h"
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace {
+    // Still pose whose x coordinate is the index of the device, so that the
+    // device a pose belongs to can be recognized
+    vr::TrackedDevicePose_t IndexPose(const vr::TrackedDeviceIndex_t index,
+                                      const double /*time*/)
+    {
+        vr::TrackedDevicePose_t pose = {};
+        auto& m = pose.mDeviceToAbsoluteTracking.m;
+        m[0][0] = m[1][1] = m[2][2] = 1;
+        m[0][3] = float(index);
+        pose.eTrackingResult = vr::TrackingResult_Running_OK;
+        pose.bPoseIsValid = true;
+        pose.bDeviceIsConnected = true;
+        return pose;
+    }
+
+    // Half turn about (0, 1, -1) / sqrt(2), whose quaternion has
+    // off-diagonal terms of opposite signs
+    vr::TrackedDevicePose_t HalfTurnPose(const vr::TrackedDeviceIndex_t index,
+                                         const double time)
+    {
+        vr::TrackedDevicePose_t pose = IndexPose(index, time);
+        auto& m = pose.mDeviceToAbsoluteTracking.m;
+        m[0][0] = -1;
+        m[1][1] = m[2][2] = 0;
+        m[1][2] = m[2][1] = -1;
+        return pose;
+    }
+
+    // Simulated time at which the device appears in the managed devices,
+    // negative if it does not appear before the timeout
+    double WaitForDevice(const openvr::DevicesManager& manager,
+                         const openvr::SimulatedBackend& backend,
+                         const std::string& serialNumber,
+                         const double timeout)
+    {
+        while (backend.time() < timeout) {
+            const auto managed = manager.managedDevices();
+            if (std::find(managed.begin(), managed.end(), serialNumber)
+                != managed.end()) {
+                return backend.time();
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+        return -1;
+    }
+
+    // Simulated backend counting the calls made while another call is in
+    // progress, the backend of OpenVR does not allow them
+    class CheckedBackend : public openvr::TrackingBackend
+    {
+    public:
+        explicit CheckedBackend(openvr::SimulatedBackend::Options options)
+            : m_simulated(std::move(options))
+        {}
+
+        const openvr::SimulatedBackend& simulated() const
+        {
+            return m_simulated;
+        }
+
+        size_t overlaps() const { return m_overlaps; }
+
+        // Duration of every property call, as a slow runtime
+        void setPropertiesDelay(const std::chrono::microseconds delay)
+        {
+            m_propertiesDelay = delay;
+        }
+
+        // Poses read while the properties of a device were being read,
+        // from its serial number to whether it is wireless
+        size_t interleavedPoses() const { return m_interleavedPoses; }
+
+        bool initialize() override
+        {
+            const Call call(*this);
+            return m_simulated.initialize();
+        }
+
+        void shutdown() override
+        {
+            const Call call(*this);
+            m_simulated.shutdown();
+        }
+
+        bool running() const override
+        {
+            const Call call(*this);
+            return m_simulated.running();
+        }
+
+        bool isTrackedDeviceConnected(
+            const vr::TrackedDeviceIndex_t index) const override
+        {
+            const Call call(*this);
+            return m_simulated.isTrackedDeviceConnected(index);
+        }
+
+        vr::ETrackedDeviceClass
+        trackedDeviceClass(const vr::TrackedDeviceIndex_t index) const override
+        {
+            const Call call(*this);
+            return m_simulated.trackedDeviceClass(index);
+        }
+
+        std::string
+        stringProperty(const vr::TrackedDeviceIndex_t index,
+                       const vr::ETrackedDeviceProperty property) const override
+        {
+            const Call call(*this, m_propertiesDelay);
+            if (property == vr::Prop_SerialNumber_String) {
+                m_readingProperties = true;
+            }
+            return m_simulated.stringProperty(index, property);
+        }
+
+        int32_t
+        int32Property(const vr::TrackedDeviceIndex_t index,
+                      const vr::ETrackedDeviceProperty property) const override
+        {
+            const Call call(*this, m_propertiesDelay);
+            return m_simulated.int32Property(index, property);
+        }
+
+        float
+        floatProperty(const vr::TrackedDeviceIndex_t index,
+                      const vr::ETrackedDeviceProperty property) const override
+        {
+            const Call call(*this, m_propertiesDelay);
+            return m_simulated.floatProperty(index, property);
+        }
+
+        bool
+        boolProperty(const vr::TrackedDeviceIndex_t index,
+                     const vr::ETrackedDeviceProperty property) const override
+        {
+            const Call call(*this, m_propertiesDelay);
+            if (property == vr::Prop_DeviceIsWireless_Bool) {
+                m_readingProperties = false;
+            }
+            return m_simulated.boolProperty(index, property);
+        }
+
+        void deviceToAbsoluteTrackingPose(
+            const vr::ETrackingUniverseOrigin origin,
+            const float predictedSecondsToPhotonsFromNow,
+            vr::TrackedDevicePose_t* poses,
+            const uint32_t count) override
+        {
+            const Call call(*this);
+            if (m_readingProperties) {
+                ++m_interleavedPoses;
+            }
+            m_simulated.deviceToAbsoluteTrackingPose(
+                origin, predictedSecondsToPhotonsFromNow, poses, count);
+        }
+
+        bool timeSinceLastVsync(float& seconds,
+                                uint64_t& frameCounter) const override
+        {
+            const Call call(*this);
+            return m_simulated.timeSinceLastVsync(seconds, frameCounter);
+        }
+
+        bool pollNextEvent(vr::VREvent_t& event) override
+        {
+            const Call call(*this);
+            return m_simulated.pollNextEvent(event);
+        }
+
+        void acknowledgeQuit() override
+        {
+            const Call call(*this);
+            m_simulated.acknowledgeQuit();
+        }
+
+        void resetZeroPose(const vr::ETrackingUniverseOrigin origin) override
+        {
+            const Call call(*this);
+            m_simulated.resetZeroPose(origin);
+        }
+
+    private:
+        class Call
+        {
+        public:
+            explicit Call(const CheckedBackend& backend,
+                          const std::chrono::microseconds duration =
+                              std::chrono::microseconds(50))
+                : m_backend(backend)
+            {
+                if (m_backend.m_calls++ > 0) {
+                    ++m_backend.m_overlaps;
+                }
+                // Widen the window in which calls could overlap
+                std::this_thread::sleep_for(duration);
+            }
+
+            ~Call() { --m_backend.m_calls; }
+
+        private:
+            const CheckedBackend& m_backend;
+        };
+
+        openvr::SimulatedBackend m_simulated;
+        mutable std::atomic<size_t> m_calls = 0;
+        mutable std::atomic<size_t> m_overlaps = 0;
+        std::atomic<std::chrono::microseconds> m_propertiesDelay =
+            std::chrono::microseconds(50);
+        mutable std::atomic<bool> m_readingProperties = false;
+        std::atomic<size_t> m_interleavedPoses = 0;
+    };
+} // namespace
+
+TEST_CASE("Poses are addressed by device index with sparse indices")
+{
+    // The tracking references at indices 1 and 2 are not managed, and the
+    // tracker at index 4 is disconnected
+    openvr::SimulatedBackend::Options options;
+    options.hmds = 1;
+    options.trackingReferences = 2;
+    options.controllers = 0;
+    options.genericTrackers = 3;
+    options.initiallyDisconnected = {4};
+    options.trajectory = &IndexPose;
+
+    openvr::DevicesManager manager(
+        std::make_unique<openvr::SimulatedBackend>(options));
+    REQUIRE(manager.initialize());
+    REQUIRE(manager.computePoses());
+
+    const std::map<size_t, std::string> expected = {
+        {0, "SIM-HMD-0"},
+        {3, "SIM-TRK-0"},
+        {5, "SIM-TRK-2"},
+    };
+
+    openvr::DevicesSnapshot snapshot;
+    REQUIRE(manager.snapshot(snapshot));
+    REQUIRE(snapshot.size == expected.size());
+
+    for (size_t i = 0; i < snapshot.size; ++i) {
+        const openvr::DeviceState& state = snapshot.devices[i];
+        INFO("Device " << state.serialNumber);
+
+        REQUIRE(expected.count(state.index) == 1);
+        CHECK(state.serialNumber == expected.at(state.index));
+        CHECK(state.valid);
+        CHECK(state.pose.position[0] == double(state.index));
+    }
+
+    for (const auto& [index, serialNumber] : expected) {
+        INFO("Device " << serialNumber);
+
+        const auto pose = manager.pose(serialNumber);
+        REQUIRE(pose);
+        CHECK(pose->position[0] == double(index));
+    }
+}
+
+TEST_CASE("Quaternions of the poses close to a half turn are exact")
+{
+    openvr::SimulatedBackend::Options options;
+    options.hmds = 0;
+    options.controllers = 0;
+    options.genericTrackers = 1;
+    options.trajectory = &HalfTurnPose;
+
+    openvr::DevicesManager manager(
+        std::make_unique<openvr::SimulatedBackend>(options));
+    REQUIRE(manager.initialize());
+    REQUIRE(manager.computePoses());
+
+    const auto pose = manager.pose("SIM-TRK-0");
+    REQUIRE(pose);
+
+    // The quaternion is (0, 0, 1, -1) / sqrt(2), with either sign
+    const auto& q = pose->quaternion;
+    CHECK(q[0] == Approx(0).margin(1e-9));
+    CHECK(q[1] == Approx(0).margin(1e-9));
+    CHECK(std::abs(q[2]) == Approx(std::sqrt(0.5)));
+    CHECK(q[3] == Approx(-q[2]));
+}
+
+TEST_CASE("Hot-plugged devices are managed within the events period")
+{
+    // The tracker at index 1 is activated once the runtime is running
+    constexpr double ActivationTime = 0.2;
+
+    openvr::SimulatedBackend::Options options;
+    options.hmds = 1;
+    options.controllers = 0;
+    options.genericTrackers = 1;
+    options.clock = openvr::SimulatedBackend::Clock::WallClock;
+    options.initiallyDisconnected = {1};
+    options.events = {
+        {ActivationTime, vr::VREvent_TrackedDeviceActivated, 1},
+    };
+
+    auto simulated = std::make_unique<openvr::SimulatedBackend>(options);
+    const openvr::SimulatedBackend& backend = *simulated;
+    openvr::DevicesManager manager(std::move(simulated));
+
+    // Margin for the scheduling of the threads
+    constexpr double Margin = 0.1;
+
+    SECTION("Events processed by the detector thread")
+    {
+        constexpr double EventsPeriod = 0.01;
+        REQUIRE(manager.setEventsPeriod(EventsPeriod));
+        REQUIRE(manager.initialize());
+
+        const double time =
+            WaitForDevice(manager, backend, "SIM-TRK-0", ActivationTime + 2);
+        REQUIRE(time >= ActivationTime);
+
+        const double latency = time - ActivationTime;
+        INFO("Hot-plug latency " << latency << " s");
+        CHECK(latency < EventsPeriod + Margin);
+    }
+
+    SECTION("Events processed by the acquisition thread")
+    {
+        // The detector alone would be too slow
+        constexpr double AcquisitionPeriod = 0.005;
+        REQUIRE(manager.setEventsPeriod(1.0));
+        REQUIRE(manager.initialize());
+        REQUIRE(manager.startAcquisition(AcquisitionPeriod));
+
+        const double time =
+            WaitForDevice(manager, backend, "SIM-TRK-0", ActivationTime + 2);
+        REQUIRE(time >= ActivationTime);
+
+        const double latency = time - ActivationTime;
+        INFO("Hot-plug latency " << latency << " s");
+        CHECK(latency < AcquisitionPeriod + Margin);
+
+        manager.stopAcquisition();
+    }
+}
+
+TEST_CASE("The backend is never called concurrently")
+{
+    // The trackers keep being deactivated and activated, while the poses
+    // are acquired
+    openvr::SimulatedBackend::Options options;
+    options.hmds = 1;
+    options.controllers = 0;
+    options.genericTrackers = 2;
+    options.clock = openvr::SimulatedBackend::Clock::WallClock;
+
+    for (size_t i = 0; i < 100; ++i) {
+        const double time = 0.005 * double(i);
+        const vr::TrackedDeviceIndex_t index = 1 + i % 2;
+        options.events.push_back(
+            {time, vr::VREvent_TrackedDeviceDeactivated, index});
+        options.events.push_back(
+            {time + 0.002, vr::VREvent_TrackedDeviceActivated, index});
+    }
+
+    auto checked = std::make_unique<CheckedBackend>(options);
+    const CheckedBackend& backend = *checked;
+    openvr::DevicesManager manager(std::move(checked));
+
+    REQUIRE(manager.setEventsPeriod(0.001));
+    REQUIRE(manager.initialize());
+
+    // The events are processed by the detector thread, the poses by this
+    // thread
+    while (backend.simulated().time() < 0.6) {
+        REQUIRE(manager.computePoses());
+    }
+
+    CHECK(backend.overlaps() == 0);
+}
+
+TEST_CASE("Reading the properties does not stall the poses")
+{
+    openvr::SimulatedBackend::Options options;
+    options.hmds = 1;
+    options.controllers = 0;
+    options.genericTrackers = 1;
+    options.clock = openvr::SimulatedBackend::Clock::WallClock;
+
+    auto checked = std::make_unique<CheckedBackend>(options);
+    CheckedBackend& backend = *checked;
+    openvr::DevicesManager manager(std::move(checked));
+
+    REQUIRE(manager.setEventsPeriod(1.0));
+    REQUIRE(manager.initialize());
+    REQUIRE(manager.managedDevices().size() == 2);
+
+    // As a slow runtime, reading all the properties of a device takes
+    // tens of milliseconds
+    backend.setPropertiesDelay(std::chrono::milliseconds(5));
+
+    // The tracker is added again, reading its properties, while the poses
+    // are computed
+    std::atomic<bool> updating = true;
+    std::thread updater([&]() {
+        for (size_t i = 0; i < 10; ++i) {
+            manager.removeDevice("SIM-TRK-0");
+            manager.addDevice(1);
+        }
+        updating = false;
+    });
+
+    while (updating) {
+        REQUIRE(manager.computePoses());
+    }
+    updater.join();
+
+    // The backend is not locked for all the properties of a device
+    CHECK(backend.interleavedPoses() > 0);
+    CHECK(backend.overlaps() == 0);
+}
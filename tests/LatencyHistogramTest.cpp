@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2021 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include "LatencyHistogram.h"
+
+#include <catch2/catch.hpp>
+
+namespace {
+    // Percentiles are upper bounds of the buckets, at most 12.5% larger than
+    // the exact value
+    void CheckBucket(const double percentile, const double expected)
+    {
+        CHECK(percentile >= expected);
+        CHECK(percentile <= expected * 1.125);
+    }
+} // namespace
+
+TEST_CASE("LatencyHistogram is empty before recording")
+{
+    openvr::LatencyHistogram histogram;
+    const auto statistics = histogram.statistics();
+
+    CHECK(statistics.count == 0);
+    CHECK(statistics.p50 == 0);
+    CHECK(statistics.p99 == 0);
+    CHECK(statistics.max == 0);
+}
+
+TEST_CASE("LatencyHistogram percentiles follow the nearest-rank definition")
+{
+    openvr::LatencyHistogram histogram;
+
+    SECTION("Three values")
+    {
+        // The ranks of p50 and p99 are ceil(1.5) = 2 and ceil(2.97) = 3
+        histogram.record(0.001);
+        histogram.record(0.002);
+        histogram.record(0.003);
+
+        const auto statistics = histogram.statistics();
+        CHECK(statistics.count == 3);
+        CheckBucket(statistics.p50, 0.002);
+        CHECK(statistics.p99 == Approx(0.003));
+        CHECK(statistics.max == Approx(0.003));
+    }
+
+    SECTION("One outlier in a hundred values")
+    {
+        for (int i = 0; i < 99; ++i) {
+            histogram.record(0.001);
+        }
+        histogram.record(0.1);
+
+        const auto statistics = histogram.statistics();
+        CHECK(statistics.count == 100);
+        CheckBucket(statistics.p50, 0.001);
+        CheckBucket(statistics.p99, 0.001);
+        CHECK(statistics.max == Approx(0.1));
+    }
+
+    SECTION("Two outliers in a hundred values")
+    {
+        for (int i = 0; i < 98; ++i) {
+            histogram.record(0.001);
+        }
+        histogram.record(0.1);
+        histogram.record(0.1);
+
+        const auto statistics = histogram.statistics();
+        CheckBucket(statistics.p99, 0.1);
+    }
+}
+
+TEST_CASE("LatencyHistogram reset clears the statistics")
+{
+    openvr::LatencyHistogram histogram;
+    histogram.record(0.5);
+    histogram.reset();
+    histogram.record(0.25);
+
+    const auto statistics = histogram.statistics();
+    CHECK(statistics.count == 1);
+    CHECK(statistics.max == Approx(0.25));
+    CheckBucket(statistics.p50, 0.25);
+}
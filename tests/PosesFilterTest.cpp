@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2021 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include "OpenVRTrackersDriver.h"
+#include "PosesFilter.h"
+
+#include <catch2/catch.hpp>
+
+#include <vector>
+
+namespace {
+    constexpr double Period = 0.01;
+
+    // Snapshot of a single tracker, still in the given position
+    openvr::DevicesSnapshot TrackerSnapshot(const double time, const double x)
+    {
+        openvr::DevicesSnapshot snapshot;
+        snapshot.timestamp = time;
+        snapshot.acquisitionTimestamp = time;
+        snapshot.size = 1;
+
+        openvr::DeviceState& state = snapshot.devices[0];
+        state.index = 1;
+        state.serialNumber = "TRK";
+        state.type = openvr::TrackedDeviceType::GenericTracker;
+        state.valid = true;
+        state.timestamp = time;
+        state.pose.position = {x, 0, 0};
+        state.pose.rotationRowMajor = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+        state.pose.quaternion = {1, 0, 0, 0};
+        state.pose.linearVelocity = {0, 0, 0};
+        state.pose.angularVelocity = {0, 0, 0};
+        state.pose.trackingResult = openvr::TrackingResult::RunningOK;
+        return snapshot;
+    }
+
+    openvr::PosesFilter KalmanFilter()
+    {
+        openvr::FilterParameters parameters;
+        parameters.type = openvr::FilterType::Kalman;
+        parameters.processNoise = 1.0;
+        parameters.measurementNoise = 0.1;
+
+        openvr::PosesFilter filter;
+        filter.setParameters(openvr::TrackedDeviceType::GenericTracker,
+                             parameters);
+        return filter;
+    }
+
+    // Filtered x coordinates of a tracker stepping from 0 to 1 after the
+    // first snapshot
+    std::vector<double> StepResponse(openvr::PosesFilter& filter,
+                                     const double startTime)
+    {
+        std::vector<double> response;
+        openvr::DevicesSnapshot filtered;
+
+        for (size_t i = 0; i < 10; ++i) {
+            filter.apply(TrackerSnapshot(startTime + i * Period, i > 0 ? 1 : 0),
+                         filtered);
+            response.push_back(filtered.devices[0].pose.position[0]);
+        }
+        return response;
+    }
+
+    void CheckEqual(const std::vector<double>& a, const std::vector<double>& b)
+    {
+        REQUIRE(a.size() == b.size());
+        for (size_t i = 0; i < a.size(); ++i) {
+            INFO("Sample " << i);
+            CHECK(a[i] == Approx(b[i]));
+        }
+    }
+} // namespace
+
+TEST_CASE("PosesFilter starts from the first measured pose")
+{
+    openvr::PosesFilter filter = KalmanFilter();
+    const std::vector<double> response = StepResponse(filter, 100);
+
+    // The step is followed smoothly
+    CHECK(response[0] == 0);
+    CHECK(response[1] > 0);
+    CHECK(response[1] < 0.9);
+    CHECK(response.back() > response[1]);
+}
+
+TEST_CASE("PosesFilter does not depend on the time of the first snapshot")
+{
+    // The first time step would be the time of the first snapshot
+    openvr::PosesFilter early = KalmanFilter();
+    openvr::PosesFilter late = KalmanFilter();
+
+    CheckEqual(StepResponse(early, 0.2), StepResponse(late, 1000));
+}
+
+TEST_CASE("PosesFilter restarts after a reset")
+{
+    openvr::PosesFilter reference = KalmanFilter();
+    const std::vector<double> expected = StepResponse(reference, 10);
+
+    openvr::PosesFilter filter = KalmanFilter();
+    StepResponse(filter, 5);
+
+    SECTION("Reset by the caller")
+    {
+        // Shortly after, the time step would be valid
+        filter.reset();
+        CheckEqual(StepResponse(filter, 5.2), expected);
+    }
+
+    SECTION("Gap between the snapshots")
+    {
+        CheckEqual(StepResponse(filter, 10), expected);
+    }
+}
+
+TEST_CASE("PosesFilter does not filter the same snapshot twice")
+{
+    openvr::PosesFilter filter = KalmanFilter();
+    StepResponse(filter, 1);
+
+    openvr::DevicesSnapshot filtered;
+    const openvr::DevicesSnapshot raw = TrackerSnapshot(1 + 10 * Period, 1);
+    filter.apply(raw, filtered);
+    const double first = filtered.devices[0].pose.position[0];
+    filter.apply(raw, filtered);
+
+    CHECK(filtered.devices[0].pose.position[0] == first);
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2021 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include "PosesPacket.h"
+
+#include <catch2/catch.hpp>
+
+#include <string>
+
+namespace {
+    void AddDevice(openvr::DevicesSnapshot& snapshot,
+                   const size_t index,
+                   const std::string& serialNumber)
+    {
+        openvr::DeviceState& state = snapshot.devices[snapshot.size++];
+        state.index = index;
+        state.serialNumber = serialNumber;
+        state.frameName = "/tracker/" + serialNumber;
+    }
+} // namespace
+
+TEST_CASE("The layout changes only with the names of the devices")
+{
+    openvr::DevicesSnapshot snapshot;
+    AddDevice(snapshot, 1, "A");
+    AddDevice(snapshot, 4, "B");
+
+    openvr::PosesLayout layout;
+    REQUIRE(layout.update(snapshot));
+    REQUIRE(layout.size == 2);
+    CHECK(layout.names[1].index == 4);
+    CHECK(std::string(layout.names[1].serialNumber) == "B");
+    CHECK(std::string(layout.names[1].frameName) == "/tracker/B");
+    const uint32_t counter = layout.counter;
+
+    SECTION("Poses")
+    {
+        snapshot.devices[0].valid = true;
+        snapshot.devices[0].pose.position = {1, 2, 3};
+        snapshot.timestamp = 1;
+
+        CHECK_FALSE(layout.update(snapshot));
+        CHECK(layout.counter == counter);
+    }
+
+    SECTION("Frame name")
+    {
+        snapshot.devices[1].frameName = "/hand";
+
+        CHECK(layout.update(snapshot));
+        CHECK(layout.counter == counter + 1);
+        CHECK(std::string(layout.names[1].frameName) == "/hand");
+    }
+
+    SECTION("Removed device")
+    {
+        snapshot.size = 1;
+
+        CHECK(layout.update(snapshot));
+        CHECK(layout.counter == counter + 1);
+        CHECK(layout.size == 1);
+    }
+
+    SECTION("Replaced device")
+    {
+        snapshot.devices[1].index = 5;
+
+        CHECK(layout.update(snapshot));
+        CHECK(layout.counter == counter + 1);
+        CHECK(layout.names[1].index == 5);
+    }
+}
+
+TEST_CASE("Long names are truncated in the layout")
+{
+    const std::string serialNumber(
+        openvr::DeviceName::NameCapacity + 10, 'S');
+
+    openvr::DevicesSnapshot snapshot;
+    AddDevice(snapshot, 0, serialNumber);
+
+    openvr::PosesLayout layout;
+    REQUIRE(layout.update(snapshot));
+
+    const std::string stored = layout.names[0].serialNumber;
+    CHECK(stored == serialNumber.substr(
+              0, openvr::DeviceName::NameCapacity - 1));
+
+    // The truncated names compare equal to the original ones
+    CHECK_FALSE(layout.update(snapshot));
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2021 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include "RcuPointer.h"
+
+#include <catch2/catch.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+    constexpr size_t MaxValues = 100001;
+
+    // Destroyed values, by number
+    std::array<std::atomic<bool>, MaxValues> Destroyed = {};
+
+    struct Value
+    {
+        explicit Value(const size_t n)
+            : number(n)
+        {
+            Destroyed[number] = false;
+        }
+
+        ~Value() { Destroyed[number] = true; }
+
+        size_t number;
+    };
+} // namespace
+
+TEST_CASE("RcuPointer returns the last published value")
+{
+    auto pointer = std::make_unique<openvr::RcuPointer<Value>>(
+        std::make_unique<const Value>(0));
+
+    CHECK(pointer->read()->number == 0);
+
+    pointer->update(std::make_unique<const Value>(1));
+    pointer->update(std::make_unique<const Value>(2));
+
+    CHECK(pointer->read()->number == 2);
+    CHECK(pointer->current().number == 2);
+
+    // The replaced values are destroyed once no reader holds them
+    CHECK(Destroyed[0]);
+    CHECK(Destroyed[1]);
+    CHECK_FALSE(Destroyed[2]);
+
+    pointer.reset();
+    CHECK(Destroyed[2]);
+}
+
+TEST_CASE("RcuPointer destroys a replaced value after its readers")
+{
+    openvr::RcuPointer<Value> pointer(std::make_unique<const Value>(0));
+    std::atomic<bool> updated = false;
+    std::thread writer;
+
+    {
+        const auto guard = pointer.read();
+
+        writer = std::thread([&]() {
+            pointer.update(std::make_unique<const Value>(1));
+            updated = true;
+        });
+
+        // The writer waits for this reader
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        CHECK_FALSE(updated);
+        CHECK_FALSE(Destroyed[0]);
+        CHECK(guard->number == 0);
+
+        // New readers already see the new value
+        CHECK(pointer.read()->number == 1);
+    }
+
+    writer.join();
+    CHECK(updated);
+    CHECK(Destroyed[0]);
+}
+
+TEST_CASE("RcuPointer readers never observe destroyed values")
+{
+    constexpr size_t Updates = MaxValues - 1;
+    constexpr size_t Readers = 3;
+
+    openvr::RcuPointer<Value> pointer(std::make_unique<const Value>(0));
+    std::atomic<bool> writing = true;
+    std::atomic<size_t> destroyed = 0;
+    std::atomic<size_t> unordered = 0;
+
+    std::vector<std::thread> readers;
+    for (size_t i = 0; i < Readers; ++i) {
+        readers.emplace_back([&]() {
+            size_t previous = 0;
+            while (writing) {
+                const auto guard = pointer.read();
+                const size_t number = guard->number;
+                if (Destroyed[number]) {
+                    ++destroyed;
+                }
+                // Values are published in order
+                if (number < previous) {
+                    ++unordered;
+                }
+                previous = number;
+            }
+        });
+    }
+
+    for (size_t number = 1; number <= Updates; ++number) {
+        pointer.update(std::make_unique<const Value>(number));
+    }
+    writing = false;
+
+    for (auto& reader : readers) {
+        reader.join();
+    }
+
+    CHECK(destroyed == 0);
+    CHECK(unordered == 0);
+    CHECK(pointer.read()->number == Updates);
+}
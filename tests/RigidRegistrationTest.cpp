@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2021 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include "RigidRegistration.h"
+#include "Rotations.h"
+
+#include <catch2/catch.hpp>
+
+#include <array>
+#include <cmath>
+
+namespace {
+    using Point = std::array<double, 3>;
+
+    Point Apply(const openvr::Transform& transform, const Point& point)
+    {
+        const auto& R = transform.rotationRowMajor;
+        Point result;
+        for (size_t i = 0; i < 3; ++i) {
+            result[i] = transform.position[i] + R[3 * i] * point[0]
+                        + R[3 * i + 1] * point[1] + R[3 * i + 2] * point[2];
+        }
+        return result;
+    }
+
+    // Transform from a normalized quaternion (w, x, y, z) and a position
+    openvr::Transform MakeTransform(const std::array<double, 4>& q,
+                                    const Point& position)
+    {
+        openvr::Transform transform;
+        transform.position = position;
+        openvr::QuaternionToRotation(q.data(),
+                                     transform.rotationRowMajor.data());
+        return transform;
+    }
+
+    const std::array<Point, 6> Sources = {{
+        {0.1, 0.2, 0.3},
+        {1.0, -0.5, 0.2},
+        {-0.7, 0.4, 1.1},
+        {0.3, 1.2, -0.4},
+        {-0.2, -0.9, -0.6},
+        {0.8, 0.6, 0.9},
+    }};
+} // namespace
+
+TEST_CASE("RigidRegistration recovers the transform between the points")
+{
+    const double h = std::sqrt(0.5);
+    const auto q = GENERATE_COPY(
+        std::array<double, 4>{1, 0, 0, 0},
+        std::array<double, 4>{std::cos(0.6), 0, std::sin(0.6), 0},
+        // Half turn about (0, 1, -1) / sqrt(2)
+        std::array<double, 4>{0, 0, h, -h},
+        // Half turn about (1, -1, 0) / sqrt(2)
+        std::array<double, 4>{0, h, -h, 0});
+    INFO("Quaternion " << q[0] << " " << q[1] << " " << q[2] << " " << q[3]);
+
+    const openvr::Transform expected = MakeTransform(q, {0.5, -1.0, 2.0});
+
+    openvr::RigidRegistration registration;
+    for (const Point& source : Sources) {
+        registration.addPair(source, Apply(expected, source));
+    }
+
+    std::array<double, 4> quaternion;
+    const auto transform = registration.solve(quaternion);
+    REQUIRE(transform);
+
+    for (size_t i = 0; i < 9; ++i) {
+        CHECK(transform->rotationRowMajor[i]
+              == Approx(expected.rotationRowMajor[i]).margin(1e-9));
+    }
+    for (size_t i = 0; i < 3; ++i) {
+        CHECK(transform->position[i] == Approx(expected.position[i]));
+    }
+    // The residual is the square root of a difference of sums
+    CHECK(registration.rms(*transform) == Approx(0).margin(1e-6));
+
+    // The quaternion is the one of the rotation, with either sign when w is
+    // zero
+    CHECK(quaternion[0] >= 0);
+    const double dot = quaternion[0] * q[0] + quaternion[1] * q[1]
+                       + quaternion[2] * q[2] + quaternion[3] * q[3];
+    CHECK(std::abs(dot) == Approx(1).epsilon(1e-9));
+}
+
+TEST_CASE("RigidRegistration requires points spanning a plane")
+{
+    openvr::RigidRegistration registration;
+    registration.addPair({0, 0, 0}, {0, 0, 0});
+    registration.addPair({1, 0, 0}, {1, 0, 0});
+    CHECK_FALSE(registration.solve());
+
+    // Collinear points
+    registration.addPair({2, 0, 0}, {2, 0, 0});
+    CHECK_FALSE(registration.solve());
+
+    registration.addPair({0, 1, 0}, {0, 1, 0});
+    CHECK(registration.solve());
+
+    registration.reset();
+    CHECK(registration.size() == 0);
+    CHECK_FALSE(registration.solve());
+}
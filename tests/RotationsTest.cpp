@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2021 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include "Rotations.h"
+
+#include <catch2/catch.hpp>
+
+#include <array>
+#include <cmath>
+
+namespace {
+    constexpr double Pi = 3.14159265358979323846;
+
+    using Rotation = std::array<double, 9>;
+    using Quaternion = std::array<double, 4>;
+
+    Quaternion AxisAngle(const double x,
+                         const double y,
+                         const double z,
+                         const double angle)
+    {
+        const double norm = std::sqrt(x * x + y * y + z * z);
+        const double s = std::sin(angle / 2) / norm;
+        return {std::cos(angle / 2), x * s, y * s, z * s};
+    }
+
+    // Quaternions q and -q are the same rotation
+    void CheckSameRotation(const Quaternion& a, const Quaternion& b)
+    {
+        const double dot =
+            a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+        CHECK(std::abs(dot) == Approx(1).epsilon(1e-9));
+    }
+} // namespace
+
+TEST_CASE("Rotations are converted to quaternions with w >= 0")
+{
+    const auto angle = GENERATE(0.0, 0.3, 1.5, 3.0, 3.14);
+    const auto axis = GENERATE(std::array<double, 3>{1, 0, 0},
+                               std::array<double, 3>{0, 1, -1},
+                               std::array<double, 3>{-1, 2, 0.5});
+    INFO("Angle " << angle);
+
+    const Quaternion expected = AxisAngle(axis[0], axis[1], axis[2], angle);
+    Rotation R;
+    openvr::QuaternionToRotation(expected.data(), R.data());
+
+    Quaternion fast;
+    Quaternion exact;
+    openvr::RotationToQuaternion(R.data(), fast.data());
+    openvr::RotationToQuaternionExact(R.data(), exact.data());
+
+    CHECK(fast[0] >= 0);
+    CHECK(exact[0] >= 0);
+    CheckSameRotation(exact, expected);
+
+    if (!openvr::CloseToHalfTurn(R.data())) {
+        CheckSameRotation(fast, expected);
+    }
+}
+
+TEST_CASE("Half turns are converted exactly")
+{
+    const auto axis = GENERATE(std::array<double, 3>{0, 1, -1},
+                               std::array<double, 3>{1, -1, 0},
+                               std::array<double, 3>{-1, 1, 1},
+                               std::array<double, 3>{0, 0, 1});
+
+    const Quaternion expected = AxisAngle(axis[0], axis[1], axis[2], Pi);
+    Rotation R;
+    openvr::QuaternionToRotation(expected.data(), R.data());
+    REQUIRE(openvr::CloseToHalfTurn(R.data()));
+
+    Quaternion q;
+    openvr::RotationToQuaternionExact(R.data(), q.data());
+    CheckSameRotation(q, expected);
+
+    // The rotation is recovered from the quaternion
+    Rotation recovered;
+    openvr::QuaternionToRotation(q.data(), recovered.data());
+    for (size_t i = 0; i < R.size(); ++i) {
+        CHECK(recovered[i] == Approx(R[i]).margin(1e-12));
+    }
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2021 Fondazione Istituto Italiano di Tecnologia
+ *
+ * Licensed under either the GNU Lesser General Public License v3.0 :
+ * https://www.gnu.org/licenses/lgpl-3.0.html
+ * or the GNU Lesser General Public License v2.1 :
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.html
+ * at your option.
+ */
+
+#include "SeqLock.h"
+
+#include <catch2/catch.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace {
+    // Large enough to be copied in several steps, all the elements are equal
+    // in a consistent value
+    using Value = std::array<uint64_t, 64>;
+
+    Value Filled(const uint64_t number)
+    {
+        Value value;
+        value.fill(number);
+        return value;
+    }
+
+    bool Consistent(const Value& value)
+    {
+        for (const uint64_t element : value) {
+            if (element != value[0]) {
+                return false;
+            }
+        }
+        return true;
+    }
+} // namespace
+
+TEST_CASE("SeqLock returns the last stored value and its version")
+{
+    openvr::SeqLock<Value> lock;
+    Value value;
+
+    CHECK(lock.version() == 0);
+    CHECK(lock.load(value) == 0);
+    CHECK(value == Filled(0));
+
+    lock.store(Filled(7));
+    lock.store(Filled(9));
+
+    CHECK(lock.version() == 2);
+    CHECK(lock.load(value) == 2);
+    CHECK(value == Filled(9));
+}
+
+TEST_CASE("SeqLock readers never observe partial writes")
+{
+    constexpr uint64_t Stores = 200000;
+    constexpr size_t Readers = 3;
+
+    openvr::SeqLock<Value> lock;
+    std::atomic<bool> writing = true;
+    std::atomic<size_t> inconsistent = 0;
+    std::atomic<size_t> unordered = 0;
+
+    std::vector<std::thread> readers;
+    for (size_t i = 0; i < Readers; ++i) {
+        readers.emplace_back([&]() {
+            Value value;
+            uint64_t previous = 0;
+            while (writing) {
+                const uint64_t version = lock.load(value);
+                if (!Consistent(value)) {
+                    ++inconsistent;
+                }
+                // The n-th store writes n, and versions never go back
+                if (value[0] != version || version < previous) {
+                    ++unordered;
+                }
+                previous = version;
+            }
+        });
+    }
+
+    for (uint64_t number = 1; number <= Stores; ++number) {
+        lock.store(Filled(number));
+    }
+    writing = false;
+
+    for (auto& reader : readers) {
+        reader.join();
+    }
+
+    CHECK(inconsistent == 0);
+    CHECK(unordered == 0);
+    CHECK(lock.version() == Stores);
+}